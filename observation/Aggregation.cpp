@@ -0,0 +1,188 @@
+#include "Aggregation.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <optional>
+#include <utility>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+const Fmi::DateTime epoch_start = Fmi::date_time::from_time_t(0);
+
+// End time of the bucket containing the given time
+Fmi::DateTime bucketEnd(const Fmi::DateTime &t, long bucket)
+{
+  const auto seconds = (t - epoch_start).total_seconds();
+  const auto end = ((seconds + bucket - 1) / bucket) * bucket;
+  return epoch_start + Fmi::Seconds(end);
+}
+
+struct Accumulator
+{
+  LocationDataItem item;  // first observation of the bucket
+  double min = std::numeric_limits<double>::max();
+  double max = std::numeric_limits<double>::lowest();
+  double sum = 0;
+  std::size_t count = 0;
+
+  void add(const LocationDataItem &obs)
+  {
+    item.data.data_quality = std::max(item.data.data_quality, obs.data.data_quality);
+    item.data.data_source = std::max(item.data.data_source, obs.data.data_source);
+    if (!obs.data.data_value)
+      return;
+    const double value = *obs.data.data_value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+    sum += value;
+    ++count;
+  }
+
+  std::optional<double> value(AggregationSpec::Function function) const
+  {
+    if (count == 0)
+      return {};
+    switch (function)
+    {
+      case AggregationSpec::Function::Min:
+        return min;
+      case AggregationSpec::Function::Max:
+        return max;
+      case AggregationSpec::Function::Sum:
+        return sum;
+      case AggregationSpec::Function::Mean:
+        break;
+    }
+    return sum / static_cast<double>(count);
+  }
+};
+
+}  // anonymous namespace
+
+long aggregationBucketSeconds(const AggregationSpec &spec)
+{
+  if (spec.interval <= 0)
+  {
+    Fmi::Exception error(BCP, "Aggregation interval must be positive");
+    error.addParameter("Interval", std::to_string(spec.interval));
+    throw error;
+  }
+  return 60L * spec.interval;
+}
+
+Fmi::DateTime aggregationStartTime(const Fmi::DateTime &starttime, const AggregationSpec &spec)
+{
+  try
+  {
+    return bucketEnd(starttime, aggregationBucketSeconds(spec));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+Fmi::DateTime aggregationEndTime(const Fmi::DateTime &endtime, const AggregationSpec &spec)
+{
+  try
+  {
+    const auto bucket = aggregationBucketSeconds(spec);
+    const auto seconds = (endtime - epoch_start).total_seconds();
+    auto end = (seconds / bucket) * bucket;
+    if (end > seconds)  // round towards minus infinity before the epoch
+      end -= bucket;
+    return epoch_start + Fmi::Seconds(end);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::string aggregationSqlFunction(const AggregationSpec &spec)
+{
+  switch (spec.function)
+  {
+    case AggregationSpec::Function::Min:
+      return "MIN";
+    case AggregationSpec::Function::Max:
+      return "MAX";
+    case AggregationSpec::Function::Sum:
+      return "SUM";
+    case AggregationSpec::Function::Mean:
+      break;
+  }
+  return "AVG";
+}
+
+LocationDataItems aggregateObservations(const LocationDataItems &observations,
+                                        const AggregationSpec &spec,
+                                        const Fmi::DateTime &starttime,
+                                        const Fmi::DateTime &endtime)
+{
+  try
+  {
+    const auto bucket = aggregationBucketSeconds(spec);
+    const auto first_start = aggregationStartTime(starttime, spec);
+    const auto last_end = aggregationEndTime(endtime, spec);
+
+    LocationDataItems ret;
+
+    // Accumulators of the current station and bucket by (measurand_id, sensor_no)
+    std::map<std::pair<int, int>, Accumulator> accumulators;
+    int fmisid = 0;
+    Fmi::DateTime end;
+
+    auto flush = [&]()
+    {
+      for (auto &item : accumulators)
+      {
+        auto &acc = item.second;
+        acc.item.data.data_time = end;
+        acc.item.data.data_value = acc.value(spec.function);
+        ret.push_back(acc.item);
+      }
+      accumulators.clear();
+    };
+
+    for (const auto &obs : observations)
+    {
+      if (obs.data.data_time <= first_start)
+        continue;
+      const auto obs_end = bucketEnd(obs.data.data_time, bucket);
+      if (obs_end > last_end)
+        continue;
+      if (!accumulators.empty() && (obs.data.fmisid != fmisid || obs_end != end))
+        flush();
+      fmisid = obs.data.fmisid;
+      end = obs_end;
+
+      auto pos = accumulators.find({obs.data.measurand_id, obs.data.sensor_no});
+      if (pos == accumulators.end())
+      {
+        pos = accumulators.emplace(std::make_pair(obs.data.measurand_id, obs.data.sensor_no),
+                                   Accumulator{obs})
+                  .first;
+      }
+      pos->second.add(obs);
+    }
+    flush();
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Aggregating observations failed!");
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "LocationDataItem.h"
+#include "Settings.h"
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Evaluation of Settings::aggregation. The observations of each station, measurand and sensor
+// are reduced to one row per time bucket, the time of the row is the end of the bucket. The
+// value is the aggregate of the non-missing values, the data quality and source are the
+// largest ones in the bucket. Buckets starting before the start or ending after the end of the
+// query are incomplete and are not returned. The SQL readers aggregate in the database, the
+// other readers must call aggregateObservations themselves.
+
+// Bucket length in seconds
+long aggregationBucketSeconds(const AggregationSpec &spec);
+
+// Start of the first complete bucket at the given time. Observations at or before it are not
+// aggregated.
+Fmi::DateTime aggregationStartTime(const Fmi::DateTime &starttime, const AggregationSpec &spec);
+
+// End of the last complete bucket at the given time. Observations after it are not aggregated.
+Fmi::DateTime aggregationEndTime(const Fmi::DateTime &endtime, const AggregationSpec &spec);
+
+// SQL aggregate function name
+std::string aggregationSqlFunction(const AggregationSpec &spec);
+
+// Aggregate observations which are ordered by time for each station. Stations may appear in
+// any order, but the observations of a station must be contiguous. Buckets starting before the
+// given start time or ending after the given end time are dropped.
+LocationDataItems aggregateObservations(const LocationDataItems &observations,
+                                        const AggregationSpec &spec,
+                                        const Fmi::DateTime &starttime,
+                                        const Fmi::DateTime &endtime);
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -1,4 +1,5 @@
 #include "CommonDatabaseFunctions.h"
+#include "Aggregation.h"
 #include "ObservationMemoryCache.h"
 #include "Utils.h"
 #include <boost/algorithm/string.hpp>
@@ -131,6 +132,8 @@ TS::TimeSeriesVectorPtr CommonDatabaseFunctions::getWeatherDataQCData(
 {
   try
   {
+    checkCancellation(settings.cancellation);
+
     // Producer 'fmi' is deprecated
     std::string stationtype = settings.stationtype;
     if (stationtype == "fmi")
@@ -139,9 +142,10 @@ TS::TimeSeriesVectorPtr CommonDatabaseFunctions::getWeatherDataQCData(
     std::string qstations;
     std::map<int, Spine::Station> fmisid_to_station;
 
+    const auto groupmask = stationInfo.groupMask(settings.stationgroups);
     for (const Spine::Station &s : stations)
     {
-      if (stationInfo.belongsToGroup(s.fmisid, settings.stationgroups))
+      if (stationInfo.belongsToGroup(s.fmisid, groupmask))
       {
         fmisid_to_station.insert(std::make_pair(s.fmisid, s));
         qstations += Fmi::to_string(s.fmisid) + ",";
@@ -234,8 +238,15 @@ TS::TimeSeriesVectorPtr CommonDatabaseFunctions::getWeatherDataQCData(
       // should use its own code instead.
 
       std::string query = sqlSelectFromWeatherDataQCData(settings, params, qstations);
-      fetchWeatherDataQCData(
-          query, stationInfo, settings.stationgroups, settings.requestLimits, observations);
+      fetchWeatherDataQCData(query,
+                             stationInfo,
+                             settings.stationgroups,
+                             settings.requestLimits,
+                             settings.cancellation,
+                             observations);
+      if (settings.aggregation)
+        observations = aggregateObservations(
+            observations, *settings.aggregation, settings.starttime, settings.endtime);
     }
 
     return buildTimeSeriesFromObservations(
@@ -91,6 +91,7 @@ class CommonDatabaseFunctions : public DBQueryUtils
                                       const StationInfo &stationInfo,
                                       const std::set<std::string> &stationgroup_codes,
                                       const TS::RequestLimits &requestLimits,
+                                      const QueryCancellationPtr &cancellation,
                                       LocationDataItems &weatherDataQCData) = 0;
   virtual std::string sqlSelectFromWeatherDataQCData(const Settings &settings,
                                                      const std::string &params,
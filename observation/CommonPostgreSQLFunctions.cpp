@@ -1,4 +1,5 @@
 #include "CommonPostgreSQLFunctions.h"
+#include "Aggregation.h"
 #include "AsDouble.h"
 #include "DatabaseDriverInfo.h"
 #include "Keywords.h"
@@ -9,6 +10,7 @@
 #include <macgyver/StringConversion.h>
 #include <macgyver/TimeFormatter.h>
 #include <spine/Value.h>
+#include <algorithm>
 #include <thread>
 
 namespace SmartMet
@@ -384,6 +386,65 @@ void CommonPostgreSQLFunctions::shutdown()
   itsDB.cancel();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Execute a query which can be cancelled by the caller
+ *
+ * The remaining time until the deadline of the query is enforced by the
+ * server as a statement timeout, and cancelling the query cancels the
+ * statement which is running in the server.
+ */
+// ----------------------------------------------------------------------
+
+pqxx::result CommonPostgreSQLFunctions::executeCancellable(const std::string &sqlStmt,
+                                                          const QueryCancellationPtr &cancellation)
+{
+  try
+  {
+    if (!cancellation)
+      return itsDB.executeNonTransaction(sqlStmt);
+
+    cancellation->check();
+
+    const auto remaining = cancellation->remaining();
+    if (remaining)
+      itsDB.executeNonTransaction("SET statement_timeout = " +
+                                  Fmi::to_string(std::max<long>(1, remaining->count())));
+
+    pqxx::result result;
+    try
+    {
+      auto registration = cancellation->onCancel([this]() { itsDB.cancel(); });
+      result = itsDB.executeNonTransaction(sqlStmt);
+    }
+    catch (...)
+    {
+      // The connection is returned to the pool, restore the default timeout
+      if (remaining)
+      {
+        try
+        {
+          itsDB.executeNonTransaction("RESET statement_timeout");
+        }
+        catch (...)
+        {
+        }
+      }
+      cancellation->check();
+      throw;
+    }
+
+    if (remaining)
+      itsDB.executeNonTransaction("RESET statement_timeout");
+
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 TS::TimeSeriesVectorPtr CommonPostgreSQLFunctions::getObservationDataForMovingStations(
     const Settings &settings,
     const TS::TimeSeriesGeneratorOptions &timeSeriesOptions,
@@ -468,7 +529,7 @@ TS::TimeSeriesVectorPtr CommonPostgreSQLFunctions::getObservationData(
 LocationDataItems CommonPostgreSQLFunctions::readObservationDataOfMovingStationsFromDB(
     const Settings &settings,
     const QueryMapping &qmap,
-    const std::set<std::string> & /* stationgroup_codes */) const
+    const std::set<std::string> & /* stationgroup_codes */)
 {
   try
   {
@@ -526,11 +587,15 @@ LocationDataItems CommonPostgreSQLFunctions::readObservationDataOfMovingStations
     if (itsDebug)
       std::cout << (itsIsCacheDatabase ? "PostgreSQL(cache): " : "PostgreSQL: ") << sqlStmt << '\n';
 
-    pqxx::result result_set = itsDB.executeNonTransaction(sqlStmt);
+    pqxx::result result_set = executeCancellable(sqlStmt, settings.cancellation);
 
     for (const auto &row : result_set)
       ret.emplace_back(parseMovingStationObservation(row));
 
+    if (settings.aggregation)
+      return aggregateObservations(
+          ret, *settings.aggregation, settings.starttime, settings.endtime);
+
     return ret;
   }
   catch (...)
@@ -544,7 +609,7 @@ LocationDataItems CommonPostgreSQLFunctions::readObservationDataFromDB(
     const Settings &settings,
     const StationInfo &stationInfo,
     const QueryMapping &qmap,
-    const std::set<std::string> &stationgroup_codes) const
+    const std::set<std::string> &stationgroup_codes)
 {
   try
   {
@@ -570,6 +635,19 @@ LocationDataItems CommonPostgreSQLFunctions::readObservationDataFromDB(
     std::string starttime = Fmi::to_iso_extended_string(settings.starttime);
     std::string endtime = Fmi::to_iso_extended_string(settings.endtime);
 
+    // Read only complete buckets. The start of the first bucket belongs to the previous one.
+    std::string startcondition = " >= '";
+    if (settings.aggregation)
+    {
+      const auto first_start = aggregationStartTime(settings.starttime, *settings.aggregation);
+      const auto last_end = aggregationEndTime(settings.endtime, *settings.aggregation);
+      if (last_end <= first_start)
+        return ret;
+      starttime = Fmi::to_iso_extended_string(first_start);
+      endtime = Fmi::to_iso_extended_string(last_end);
+      startcondition = " > '";
+    }
+
     // Determine table and columns based on database type
     std::string tableName = itsIsCacheDatabase ? "observation_data" : "observation_data_r1";
     std::string idColumn = itsIsCacheDatabase ? "fmisid" : "station_id";
@@ -578,11 +656,22 @@ LocationDataItems CommonPostgreSQLFunctions::readObservationDataFromDB(
         itsIsCacheDatabase ? "data.data_time" : "date_trunc('seconds', data.data_time)";
 
     // Construct base SQL statement
-    std::string sqlStmt =
-        "SELECT data." + stationColumn + ", data.sensor_no AS sensor_no, EXTRACT(EPOCH FROM " +
-        timestampColumn +
-        ") AS obstime, data.measurand_id, data_value, data_quality, data_source FROM " + tableName +
-        " data ";
+    std::string sqlStmt;
+    if (!settings.aggregation)
+      sqlStmt = "SELECT data." + stationColumn +
+                ", data.sensor_no AS sensor_no, EXTRACT(EPOCH FROM " + timestampColumn +
+                ") AS obstime, data.measurand_id, data_value, data_quality, data_source FROM " +
+                tableName + " data ";
+    else
+    {
+      // Aggregate into time buckets ending at multiples of the bucket length
+      const auto bucket = Fmi::to_string(aggregationBucketSeconds(*settings.aggregation));
+      sqlStmt = "SELECT data." + stationColumn +
+                ", data.sensor_no AS sensor_no, CAST(CEIL(EXTRACT(EPOCH FROM " + timestampColumn +
+                ") / " + bucket + ") * " + bucket + " AS BIGINT) AS obstime, data.measurand_id, " +
+                aggregationSqlFunction(*settings.aggregation) +
+                "(data_value), MAX(data_quality), MAX(data_source) FROM " + tableName + " data ";
+    }
 
     // Using JOIN on large station lists may be faster than just using an IN clause.
     // PostgreSQL converts the IN clause into a "if x=A or x=B or x=C ..." clause, so
@@ -596,8 +685,8 @@ LocationDataItems CommonPostgreSQLFunctions::readObservationDataFromDB(
           "WHERE o." +
           idColumn + " IN (" + stationsql + ")";
 
-    sqlStmt += " AND data.data_time >= '" + starttime + "' AND data.data_time <= '" + endtime +
-               "' AND data.measurand_id IN (" + measurand_ids + ") ";
+    sqlStmt += " AND data.data_time" + startcondition + starttime + "' AND data.data_time <= '" +
+               endtime + "' AND data.measurand_id IN (" + measurand_ids + ") ";
 
     // Add producer ID filter if needed
     if (!producerIds.empty())
@@ -607,18 +696,26 @@ LocationDataItems CommonPostgreSQLFunctions::readObservationDataFromDB(
     sqlStmt += getSensorQueryCondition(qmap.sensorNumberToMeasurandIds);
     sqlStmt += "AND " + settings.dataFilter.getSqlClause("data_quality", "data.data_quality") + " ";
 
+    if (settings.aggregation)
+      sqlStmt += "GROUP BY 1, 2, 3, 4 ";
+
     // Add ordering clause
     sqlStmt += "ORDER BY fmisid ASC, obstime ASC";
 
     if (itsDebug)
       std::cout << (itsIsCacheDatabase ? "PostgreSQL(cache): " : "PostgreSQL: ") << sqlStmt << '\n';
 
-    pqxx::result result_set = itsDB.executeNonTransaction(sqlStmt);
+    pqxx::result result_set = executeCancellable(sqlStmt, settings.cancellation);
 
     std::set<Fmi::DateTime> obstimes;
     std::set<int> fmisids;
+    std::size_t nrows = 0;
     for (auto row : result_set)
     {
+      // Converting a large result may take a while too
+      if ((++nrows & 0xfff) == 0)
+        checkCancellation(settings.cancellation);
+
       LocationDataItem obs;
       obs.data.fmisid = as_int(row[0]);
       obs.data.sensor_no = as_int(row[1]);
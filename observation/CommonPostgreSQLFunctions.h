@@ -75,12 +75,15 @@ class CommonPostgreSQLFunctions : public CommonDatabaseFunctions
       const Settings &settings,
       const StationInfo &stationInfo,
       const QueryMapping &qmap,
-      const std::set<std::string> &stationgroup_codes) const;
+      const std::set<std::string> &stationgroup_codes);
 
   LocationDataItems readObservationDataOfMovingStationsFromDB(
       const Settings &settings,
       const QueryMapping &qmap,
-      const std::set<std::string> &stationgroup_codes) const;
+      const std::set<std::string> &stationgroup_codes);
+
+  pqxx::result executeCancellable(const std::string &sqlStmt,
+                                  const QueryCancellationPtr &cancellation);
 };
 
 }  // namespace Observation
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Priority classes for database connections. Background cache updates, interactive
+// queries and administrative requests share the same pools, the classes are used to
+// keep any one of them from starving the others.
+
+enum class ConnectionPriority
+{
+  Interactive = 0,  // values(), makeQuery() etc
+  CacheUpdate = 1,  // background cache update loops
+  Admin = 2         // station reloads, metadata queries
+};
+
+constexpr std::size_t CONNECTION_PRIORITY_COUNT = 3;
+
+struct ConnectionPriorityLimits
+{
+  std::size_t reserved = 0;         // connections kept available for this class only
+  std::size_t maxPercentage = 100;  // max share of the pool this class may use
+};
+
+using ConnectionPriorityLimitsArray =
+    std::array<ConnectionPriorityLimits, CONNECTION_PRIORITY_COUNT>;
+
+inline std::size_t priorityIndex(ConnectionPriority priority)
+{
+  return static_cast<std::size_t>(priority);
+}
+
+// Names used in configuration files and diagnostics
+inline const std::string& priorityName(ConnectionPriority priority)
+{
+  static const std::array<std::string, CONNECTION_PRIORITY_COUNT> names{
+      "interactive", "cache_update", "admin"};
+  return names.at(priorityIndex(priority));
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
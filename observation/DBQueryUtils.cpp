@@ -1,11 +1,17 @@
 #include "DBQueryUtils.h"
 #include "DataWithQuality.h"
+#include "LocalTimeCache.h"
 #include "SpecialParameters.h"
 #include "Utils.h"
+#include "WorkerPool.h"
+#include <macgyver/Cache.h>
 #include <newbase/NFmiMetMath.h>  //For FeelsLike calculation
 #include <timeseries/ParameterTools.h>
 
 #include <timeseries/TimeSeriesOutput.h>
+#include <algorithm>
+#include <iterator>
+#include <mutex>
 #include <unordered_map>
 
 namespace SmartMet
@@ -16,11 +22,6 @@ namespace Observation
 {
 using namespace Utils;
 
-#define LONGITUDE_MEASURAND_ID 6767676
-#define LATITUDE_MEASURAND_ID 4545454
-#define ELEVATION_MEASURAND_ID 2323232
-
-
 namespace
 {
 enum class DataFieldSpecifier
@@ -61,68 +62,135 @@ bool is_data_quality_field(const std::string &fieldname)
            fieldname.find("_data_quality_sensornumber_") != std::string::npos));
 }
 
-TS::Value get_default_sensor_value(const SensorData &sensor_data,
-                                   DataFieldSpecifier specifier = DataFieldSpecifier::Value)
+TS::Value field_value(const DataWithQuality &data, DataFieldSpecifier specifier)
 {
-  try
+  if (specifier == DataFieldSpecifier::Value)
+    return data.value;
+  if (specifier == DataFieldSpecifier::DataQuality)
+    return data.data_quality;
+  if (specifier == DataFieldSpecifier::DataSource)
+    return data.data_source;
+  return TS::None();
+}
+
+// Observations of a single (fmisid, data_time) group. Measurands are indexed by the dense slot
+// numbers assigned in buildPrecomputedParams, and all storage is reused from group to group so
+// that emitting a row does not allocate.
+class GroupValues
+{
+ public:
+  explicit GroupValues(std::size_t nslots) : itsHeads(nslots, -1) {}
+
+  void clear()
+  {
+    for (const auto slot : itsUsedSlots)
+      itsHeads[slot] = -1;
+    itsUsedSlots.clear();
+    itsEntries.clear();
+    itsLocation = nullptr;
+  }
+
+  // Store the value of a sensor, a later value for the same sensor replaces the earlier one
+  void add(int slot, int sensor_no, const DataWithQuality &data)
   {
-    for (const auto &item : sensor_data)
+    for (int i = itsHeads[slot]; i >= 0; i = itsEntries[i].next)
     {
-      if (item.second.is_default_sensor_data)
+      if (itsEntries[i].sensor_no == sensor_no)
       {
-        if (specifier == DataFieldSpecifier::Value)
-          return item.second.value;
-        if (specifier == DataFieldSpecifier::DataQuality)
-          return item.second.data_quality;
-        if (specifier == DataFieldSpecifier::DataSource)
-          return item.second.data_source;
+        itsEntries[i].data = data;
+        return;
       }
     }
+    if (itsHeads[slot] < 0)
+      itsUsedSlots.push_back(slot);
+    itsEntries.push_back(Entry{sensor_no, itsHeads[slot], data});
+    itsHeads[slot] = static_cast<int>(itsEntries.size() - 1);
+  }
 
-    // If no default sensor found return the first
-    const auto &default_item = *(sensor_data.begin());
+  bool has(int slot) const { return slot >= 0 && itsHeads[slot] >= 0; }
 
-    if (specifier == DataFieldSpecifier::Value)
-      return default_item.second.value;
-    if (specifier == DataFieldSpecifier::DataQuality)
-      return default_item.second.data_quality;
-    if (specifier == DataFieldSpecifier::DataSource)
-      return default_item.second.data_source;
+  // The default sensor with the smallest number, or the smallest sensor number if there is
+  // no default sensor
+  const DataWithQuality *defaultSensor(int slot) const
+  {
+    const Entry *best = nullptr;
+    for (int i = (slot >= 0 ? itsHeads[slot] : -1); i >= 0; i = itsEntries[i].next)
+    {
+      const auto &entry = itsEntries[i];
+      if (!best || isBetterDefault(entry, *best))
+        best = &entry;
+    }
+    return (best ? &best->data : nullptr);
+  }
 
-    return TS::None();
+  const DataWithQuality *sensor(int slot, int sensor_no) const
+  {
+    for (int i = (slot >= 0 ? itsHeads[slot] : -1); i >= 0; i = itsEntries[i].next)
+      if (itsEntries[i].sensor_no == sensor_no)
+        return &itsEntries[i].data;
+    return nullptr;
   }
-  catch (...)
+
+  // Observation whose location is reported, selected like the default sensor
+  void addLocation(const LocationDataItem *obs, int sensor_no, bool is_default)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed");
+    if (!itsLocation || (is_default && !itsLocationIsDefault) ||
+        (is_default == itsLocationIsDefault && sensor_no <= itsLocationSensor))
+    {
+      itsLocation = obs;
+      itsLocationSensor = sensor_no;
+      itsLocationIsDefault = is_default;
+    }
+  }
+
+  const LocationDataItem *location() const { return itsLocation; }
+
+ private:
+  struct Entry
+  {
+    int sensor_no;
+    int next;  // next sensor of the same measurand, -1 if none
+    DataWithQuality data;
+  };
+
+  static bool isBetterDefault(const Entry &a, const Entry &b)
+  {
+    if (a.data.is_default_sensor_data != b.data.is_default_sensor_data)
+      return a.data.is_default_sensor_data;
+    return a.sensor_no < b.sensor_no;
   }
+
+  std::vector<int> itsHeads;  // slot -> first entry, -1 if none
+  std::vector<int> itsUsedSlots;
+  std::vector<Entry> itsEntries;
+  const LocationDataItem *itsLocation = nullptr;
+  int itsLocationSensor = 0;
+  bool itsLocationIsDefault = false;
+};
+
+TS::Value get_default_sensor_value(const GroupValues &group,
+                                   int slot,
+                                   DataFieldSpecifier specifier = DataFieldSpecifier::Value)
+{
+  const auto *data = group.defaultSensor(slot);
+  return (data ? field_value(*data, specifier) : TS::None());
 }
 
-TS::Value get_sensor_value(const SensorData &sensor_data,
+TS::Value get_sensor_value(const GroupValues &group,
+                           int slot,
                            const std::string &sensor_no,
                            DataFieldSpecifier specifier = DataFieldSpecifier::Value)
 {
   try
   {
-    if (sensor_data.empty())
+    if (!group.has(slot))
       return TS::None();
 
     if (sensor_no == "default" || sensor_no.empty())
-      return get_default_sensor_value(sensor_data, specifier);
-
-    int sensor_nro = Fmi::stoi(sensor_no);
-    if (sensor_data.find(sensor_nro) != sensor_data.end())
-    {
-      if (specifier == DataFieldSpecifier::Value)
-        return sensor_data.at(sensor_nro).value;
-
-      if (specifier == DataFieldSpecifier::DataQuality)
-        return sensor_data.at(sensor_nro).data_quality;
-
-      if (specifier == DataFieldSpecifier::DataSource)
-        return sensor_data.at(sensor_nro).data_source;
-    }
+      return get_default_sensor_value(group, slot, specifier);
 
-    return TS::None();
+    const auto *data = group.sensor(slot, Fmi::stoi(sensor_no));
+    return (data ? field_value(*data, specifier) : TS::None());
   }
   catch (...)
   {
@@ -245,8 +313,8 @@ void fillMissingTimesteps(const TS::TimeSeriesVectorPtr &resultVector,
 struct RegularParamEntry
 {
   int output_pos;
-  int measurand_id;
-  int sensor_no;  // -1 = use default sensor
+  int measurand_id;  // measurand slot after buildPrecomputedParams
+  int sensor_no;     // -1 = use default sensor
 };
 
 // Pre-computed info for a special/derived output parameter
@@ -273,6 +341,7 @@ struct SpecialParamEntry
   int output_pos = 0;
   Kind kind{Kind::Other};
   std::string name;                   // for Kind::Other
+  // Measurand IDs are resolved to dense measurand slots in buildPrecomputedParams
   int mid1 = 0, mid2 = 0, mid3 = 0;  // pre-resolved measurand IDs
   std::array<int, 5> cla_mids{};
   std::array<int, 5> clhb_mids{};
@@ -286,6 +355,22 @@ struct PrecomputedParams
   std::vector<RegularParamEntry> regular;
   std::vector<SpecialParamEntry> special;
   std::vector<int> all_quality_measurand_ids;  // for DataQuality "last match wins"
+
+  // Dense slot numbers of the measurands needed for the output. Observations of other
+  // measurands are not needed for the result.
+  std::unordered_map<int, int> measurand_slots;
+
+  int addSlot(int measurand_id)
+  {
+    return measurand_slots.emplace(measurand_id, static_cast<int>(measurand_slots.size()))
+        .first->second;
+  }
+
+  int slot(int measurand_id) const
+  {
+    const auto pos = measurand_slots.find(measurand_id);
+    return (pos != measurand_slots.end() ? pos->second : -1);
+  }
 };
 
 SpecialParamEntry::Kind windCompassKind(const std::string &name)
@@ -439,9 +524,70 @@ PrecomputedParams buildPrecomputedParams(const QueryMapping &qmap,
     result.special.push_back(
         buildSpecialParamEntry(special.first, special.second, isQCTable, parameterMap, stationtype, qmap));
 
+  // Remap the measurand IDs to dense slots
+  for (auto &entry : result.regular)
+    entry.measurand_id = result.addSlot(entry.measurand_id);
+  for (auto &mid : result.all_quality_measurand_ids)
+    mid = result.addSlot(mid);
+  for (auto &entry : result.special)
+  {
+    entry.mid1 = result.addSlot(entry.mid1);
+    entry.mid2 = result.addSlot(entry.mid2);
+    entry.mid3 = result.addSlot(entry.mid3);
+    for (auto &mid : entry.cla_mids)
+      mid = result.addSlot(mid);
+    for (auto &mid : entry.clhb_mids)
+      mid = result.addSlot(mid);
+    if (entry.kind == SpecialParamEntry::Kind::DataSource)
+      entry.measurand_id = (entry.measurand_id > 0 ? result.addSlot(entry.measurand_id) : -1);
+  }
+
   return result;
 }
 
+// Compiled parameter mapping of a query. Plans are shared by all queries with the same
+// stationtype and parameter list, the precomputed parameters are resolved on first use.
+struct QueryPlan
+{
+  QueryMapping qmap;
+  std::once_flag precomputed;
+  PrecomputedParams procParams;
+  std::map<int, std::string> continuous;
+};
+
+using QueryPlanPtr = std::shared_ptr<QueryPlan>;
+
+std::atomic<bool> query_plans_enabled{false};
+
+Fmi::Cache::Cache<std::string, QueryPlanPtr> &query_plan_cache()
+{
+  static Fmi::Cache::Cache<std::string, QueryPlanPtr> cache;
+  return cache;
+}
+
+// Plan key: stationtype, table type and the normalized parameter list
+std::string query_plan_key(const Settings &settings,
+                           const std::string &stationtype,
+                           bool isWeatherDataQCTable)
+{
+  std::string key = stationtype;
+  key += (isWeatherDataQCTable ? "|qc" : "|obs");
+  for (const auto &p : settings.parameters)
+  {
+    std::string name = p.name();
+    Fmi::ascii_tolower(name);
+    key += '|';
+    key += name;
+    key += ':';
+    key += Fmi::to_string(static_cast<int>(p.type()));
+    key += ':';
+    key += (p.getSensorNumber() ? Fmi::to_string(*p.getSensorNumber()) : "default");
+    key += ':';
+    key += p.getSensorParameter();
+  }
+  return key;
+}
+
 // Compute valid timestep sets from sorted observations (no LocalDateTime map key needed)
 // Case 2 of computeValidTimestepsSorted: find the single closest timestamp per fmisid to wantedtime.
 std::map<int, std::set<Fmi::LocalDateTime>> computeWantedTimestepsSorted(
@@ -584,8 +730,8 @@ std::map<int, std::set<Fmi::LocalDateTime>> computeValidTimestepsSorted(
 
   // Cases 1 and 3: scan data timestamps
   std::map<int, std::set<Fmi::LocalDateTime>> result;
-  auto current_tz_name = settings.timezone;
-  auto current_tz = timezones.time_zone_from_string(current_tz_name);
+  LocalTimeCache localtimes(timezones);
+  auto *current_tz = &localtimes.zone(settings.timezone);
   int prev_fmisid = -1;
   Fmi::DateTime prev_utctime;
   bool prev_valid = false;
@@ -604,19 +750,12 @@ std::map<int, std::set<Fmi::LocalDateTime>> computeValidTimestepsSorted(
       continue;
 
     if (fmisid != prev_fmisid && settings.timezone == "localtime")
-    {
-      const auto &tz_name = fmisid_to_station.at(fmisid).timezone;
-      if (tz_name != current_tz_name)
-      {
-        current_tz_name = tz_name;
-        current_tz = timezones.time_zone_from_string(current_tz_name);
-      }
-    }
+      current_tz = &localtimes.zone(fmisid_to_station.at(fmisid).timezone);
     prev_fmisid = fmisid;
     prev_utctime = utctime;
     prev_valid = true;
 
-    Fmi::LocalDateTime ldt(utctime, current_tz);
+    const auto ldt = current_tz->localTime(utctime);
     if (timeSeriesOptions.all())
       result[fmisid].insert(ldt);  // case 1: per-fmisid data timestamps
     else
@@ -678,84 +817,70 @@ TimestepsByFMISID collectWantedTimesteps(const std::map<int, TS::TimeSeriesVecto
   return fmisid_timesteps;
 }
 
-using GroupData = std::unordered_map<int, SensorData>;
-
-// Collect all observations at a single (fmisid, data_time) into a measurand_id → sensor_no → value map.
-// Advances 'it' past the consumed observations.
-GroupData collectGroupData(std::vector<const LocationDataItem *>::const_iterator &it,
-                           std::vector<const LocationDataItem *>::const_iterator end,
-                           int grp_fmisid,
-                           const Fmi::DateTime &grp_utctime,
-                           bool isWeatherDataQCTable)
+// Collect all observations at a single (fmisid, data_time) into the measurand slots of the
+// group. Advances 'it' past the consumed observations.
+void collectGroupData(std::vector<const LocationDataItem *>::const_iterator &it,
+                      std::vector<const LocationDataItem *>::const_iterator end,
+                      int grp_fmisid,
+                      const Fmi::DateTime &grp_utctime,
+                      bool isWeatherDataQCTable,
+                      const PrecomputedParams &procParams,
+                      GroupValues &group_data)
 {
-  GroupData group_data;
+  group_data.clear();
   while (it != end && (*it)->data.fmisid == grp_fmisid && (*it)->data.data_time == grp_utctime)
   {
     const auto &obs = **it;
     const bool is_default = isWeatherDataQCTable ? (obs.data.sensor_no == 1)
                                                  : (obs.data.measurand_no == 1);
-    const auto value = (obs.data.data_value ? TS::Value(*obs.data.data_value) : TS::None());
-    TS::Value dq;
-    if (isWeatherDataQCTable)
-      dq = obs.data.data_quality ? TS::Value(obs.data.data_quality) : TS::None();
-    else
-      dq = TS::Value(obs.data.data_quality);
-    TS::Value ds;
-    if (isWeatherDataQCTable)
-      ds = TS::None();
-    else
-      ds = obs.data.data_source > -1 ? TS::Value(obs.data.data_source) : TS::None();
-
-    group_data[obs.data.measurand_id][obs.data.sensor_no] = DataWithQuality(value, dq, ds, is_default);
     if (!isWeatherDataQCTable)
+      group_data.addLocation(&obs, obs.data.sensor_no, is_default);
+
+    const int slot = procParams.slot(obs.data.measurand_id);
+    if (slot >= 0)
     {
-      group_data[LONGITUDE_MEASURAND_ID][obs.data.sensor_no] =
-          DataWithQuality(TS::Value(obs.longitude), dq, ds, is_default);
-      group_data[LATITUDE_MEASURAND_ID][obs.data.sensor_no] =
-          DataWithQuality(TS::Value(obs.latitude), dq, ds, is_default);
-      group_data[ELEVATION_MEASURAND_ID][obs.data.sensor_no] =
-          DataWithQuality(TS::Value(obs.elevation), dq, ds, is_default);
+      const auto value = (obs.data.data_value ? TS::Value(*obs.data.data_value) : TS::None());
+      TS::Value dq;
+      if (isWeatherDataQCTable)
+        dq = obs.data.data_quality ? TS::Value(obs.data.data_quality) : TS::None();
+      else
+        dq = TS::Value(obs.data.data_quality);
+      TS::Value ds;
+      if (isWeatherDataQCTable)
+        ds = TS::None();
+      else
+        ds = obs.data.data_source > -1 ? TS::Value(obs.data.data_source) : TS::None();
+
+      group_data.add(slot, obs.data.sensor_no, DataWithQuality(value, dq, ds, is_default));
     }
     ++it;
   }
-  return group_data;
 }
 
 // Emit all regular (non-special) parameters for a single (fmisid, timestep) group.
 void emitRegularParams(const PrecomputedParams &procParams,
-                       const GroupData &group_data,
+                       const GroupValues &group_data,
                        const Fmi::LocalDateTime &ldt,
                        TS::TimeSeriesVectorPtr &resultVector)
 {
   for (const auto &rp : procParams.regular)
   {
-    TS::Value val = TS::None();
-    const auto mit = group_data.find(rp.measurand_id);
-    if (mit != group_data.end())
-    {
-      if (rp.sensor_no < 0)
-        val = get_default_sensor_value(mit->second);
-      else
-      {
-        const auto sit = mit->second.find(rp.sensor_no);
-        val = (sit != mit->second.end()) ? sit->second.value : TS::None();
-      }
-    }
+    const auto *data = (rp.sensor_no < 0 ? group_data.defaultSensor(rp.measurand_id)
+                                         : group_data.sensor(rp.measurand_id, rp.sensor_no));
+    const TS::Value val = (data ? data->value : TS::None());
     resultVector->at(rp.output_pos).emplace_back(TS::TimedValue(ldt, val));
   }
 }
 
 // Compute cloud ceiling value (in meters, feet, or hundreds-of-feet) from group data.
-TS::Value computeCloudCeiling(const SpecialParamEntry &sp, const GroupData &group_data)
+TS::Value computeCloudCeiling(const SpecialParamEntry &sp, const GroupValues &group_data)
 {
   for (int i = 0; i < 5; i++)
   {
-    const auto cla_it = group_data.find(sp.cla_mids[i]);
-    const auto clhb_it = group_data.find(sp.clhb_mids[i]);
-    if (cla_it != group_data.end() && clhb_it != group_data.end())
+    if (group_data.has(sp.cla_mids[i]) && group_data.has(sp.clhb_mids[i]))
     {
-      double cla_val = std::get<double>(get_default_sensor_value(cla_it->second));
-      double clhb_val = std::get<double>(get_default_sensor_value(clhb_it->second));
+      double cla_val = std::get<double>(get_default_sensor_value(group_data, sp.cla_mids[i]));
+      double clhb_val = std::get<double>(get_default_sensor_value(group_data, sp.clhb_mids[i]));
       if (cla_val >= 5 && cla_val <= 9)
       {
         if (sp.kind == SpecialParamEntry::Kind::CloudCeilingFt)
@@ -782,27 +907,24 @@ std::string windCompassString(SpecialParamEntry::Kind kind,
 }
 
 // Resolve the data_source value for a DataSource special parameter entry.
-TS::Value dataSourceValue(const SpecialParamEntry &sp, const GroupData &group_data)
+TS::Value dataSourceValue(const SpecialParamEntry &sp, const GroupValues &group_data)
 {
-  if (sp.measurand_id <= 0)
-    return TS::None();
-  const auto mit = group_data.find(sp.measurand_id);
-  if (mit == group_data.end())
+  if (!group_data.has(sp.measurand_id))
     return TS::None();
-  return get_sensor_value(mit->second, sp.sensor_number, DataFieldSpecifier::DataSource);
+  return get_sensor_value(
+      group_data, sp.measurand_id, sp.sensor_number, DataFieldSpecifier::DataSource);
 }
 
 // Resolve the data_quality value for a DataQuality entry ("last match wins").
 TS::Value dataQualityValue(const SpecialParamEntry &sp,
-                           const GroupData &group_data,
+                           const GroupValues &group_data,
                            const PrecomputedParams &procParams)
 {
   TS::Value val = TS::None();
-  for (const int mid : procParams.all_quality_measurand_ids)
+  for (const int slot : procParams.all_quality_measurand_ids)
   {
-    const auto mit = group_data.find(mid);
-    if (mit != group_data.end())
-      val = get_sensor_value(mit->second, sp.sensor_number, DataFieldSpecifier::DataQuality);
+    if (group_data.has(slot))
+      val = get_sensor_value(group_data, slot, sp.sensor_number, DataFieldSpecifier::DataQuality);
   }
   return val;
 }
@@ -810,7 +932,7 @@ TS::Value dataQualityValue(const SpecialParamEntry &sp,
 // Emit a single special parameter entry (one switch-case dispatch + try/catch).
 void emitSpecialParam(const SpecialParamEntry &sp,
                       const Fmi::LocalDateTime &ldt,
-                      const GroupData &group_data,
+                      const GroupValues &group_data,
                       const PrecomputedParams &procParams,
                       const SpecialParameters::Args &args,
                       const Settings &settings,
@@ -825,22 +947,22 @@ void emitSpecialParam(const SpecialParamEntry &sp,
     {
     case SpecialParamEntry::Kind::Longitude:
     {
-      const auto mit = group_data.find(LONGITUDE_MEASURAND_ID);
-      const TS::Value val = (mit != group_data.end()) ? get_default_sensor_value(mit->second) : missing;
+      const auto *location = group_data.location();
+      const TS::Value val = (location ? TS::Value(location->longitude) : missing);
       resultVector->at(pos).emplace_back(TS::TimedValue(ldt, val));
       break;
     }
     case SpecialParamEntry::Kind::Latitude:
     {
-      const auto mit = group_data.find(LATITUDE_MEASURAND_ID);
-      const TS::Value val = (mit != group_data.end()) ? get_default_sensor_value(mit->second) : missing;
+      const auto *location = group_data.location();
+      const TS::Value val = (location ? TS::Value(location->latitude) : missing);
       resultVector->at(pos).emplace_back(TS::TimedValue(ldt, val));
       break;
     }
     case SpecialParamEntry::Kind::Elevation:
     {
-      const auto mit = group_data.find(ELEVATION_MEASURAND_ID);
-      const TS::Value val = (mit != group_data.end()) ? get_default_sensor_value(mit->second) : missing;
+      const auto *location = group_data.location();
+      const TS::Value val = (location ? TS::Value(location->elevation) : missing);
       resultVector->at(pos).emplace_back(TS::TimedValue(ldt, val));
       break;
     }
@@ -848,8 +970,7 @@ void emitSpecialParam(const SpecialParamEntry &sp,
     case SpecialParamEntry::Kind::WindCompass16:
     case SpecialParamEntry::Kind::WindCompass32:
     {
-      const auto mit = group_data.find(sp.mid1);
-      const TS::Value val = (mit != group_data.end()) ? get_default_sensor_value(mit->second) : missing;
+      const TS::Value val = get_default_sensor_value(group_data, sp.mid1);
       const TS::Value result =
           (val == TS::None())
               ? missing
@@ -859,18 +980,16 @@ void emitSpecialParam(const SpecialParamEntry &sp,
     }
     case SpecialParamEntry::Kind::FeelsLike:
     {
-      const auto wit = group_data.find(sp.mid1);  // windspeedms
-      const auto rit = group_data.find(sp.mid2);  // relativehumidity
-      const auto tit = group_data.find(sp.mid3);  // temperature
-      if (wit == group_data.end() || rit == group_data.end() || tit == group_data.end())
+      // windspeedms, relativehumidity, temperature
+      if (!group_data.has(sp.mid1) || !group_data.has(sp.mid2) || !group_data.has(sp.mid3))
       {
         resultVector->at(pos).emplace_back(TS::TimedValue(ldt, missing));
       }
       else
       {
-        const float wind = std::get<double>(get_default_sensor_value(wit->second));
-        const float rh = std::get<double>(get_default_sensor_value(rit->second));
-        const float temp = std::get<double>(get_default_sensor_value(tit->second));
+        const float wind = std::get<double>(get_default_sensor_value(group_data, sp.mid1));
+        const float rh = std::get<double>(get_default_sensor_value(group_data, sp.mid2));
+        const float temp = std::get<double>(get_default_sensor_value(group_data, sp.mid3));
         resultVector->at(pos).emplace_back(
             TS::TimedValue(ldt, TS::Value(FmiFeelsLikeTemperature(wind, rh, temp, kFloatMissing))));
       }
@@ -878,18 +997,18 @@ void emitSpecialParam(const SpecialParamEntry &sp,
     }
     case SpecialParamEntry::Kind::SmartSymbol:
     {
-      const auto wit = group_data.find(sp.mid1);  // wawa
-      const auto cit = group_data.find(sp.mid2);  // totalcloudcover
-      const auto tit = group_data.find(sp.mid3);  // temperature
-      if (wit == group_data.end() || cit == group_data.end() || tit == group_data.end())
+      // wawa, totalcloudcover, temperature
+      if (!group_data.has(sp.mid1) || !group_data.has(sp.mid2) || !group_data.has(sp.mid3))
       {
         resultVector->at(pos).emplace_back(TS::TimedValue(ldt, missing));
       }
       else
       {
-        const int wawa = static_cast<int>(std::get<double>(get_default_sensor_value(wit->second)));
-        const int totalcc = static_cast<int>(std::get<double>(get_default_sensor_value(cit->second)));
-        const float temp = std::get<double>(get_default_sensor_value(tit->second));
+        const int wawa =
+            static_cast<int>(std::get<double>(get_default_sensor_value(group_data, sp.mid1)));
+        const int totalcc =
+            static_cast<int>(std::get<double>(get_default_sensor_value(group_data, sp.mid2)));
+        const float temp = std::get<double>(get_default_sensor_value(group_data, sp.mid3));
         const auto value =
             calcSmartsymbolNumber(wawa, totalcc, temp, ldt, station.latitude, station.longitude);
         if (!value)
@@ -932,30 +1051,6 @@ void skipFmisidGroup(std::vector<const LocationDataItem *>::const_iterator &it,
     ++it;
 }
 
-// Finalize a completed station: fills resultVector into timeSeriesColumns for the station's valid
-// timesteps. Returns timeSeriesColumns if the caller should early-return (no data yet), else nullptr.
-// No-op (returns nullptr) when station is nullptr.
-TS::TimeSeriesVectorPtr tryFinalizeStation(int fmisid,
-                                           const TimestepsByFMISID &fmisid_valid_timesteps,
-                                           const std::map<int, std::string> &continuous,
-                                           const Spine::Station *station,
-                                           const std::string &stationtype,
-                                           const Settings &settings,
-                                           TS::TimeSeriesVectorPtr &resultVector,
-                                           TS::TimeSeriesVectorPtr &timeSeriesColumns)
-{
-  if (!station)
-    return nullptr;
-  const auto ts_it = fmisid_valid_timesteps.find(fmisid);
-  if (ts_it == fmisid_valid_timesteps.end())
-    return nullptr;
-  if (resultVector->empty() || resultVector->at(0).empty())
-    return timeSeriesColumns;
-  fillMissingTimesteps(
-      resultVector, timeSeriesColumns, ts_it->second, continuous, *station, stationtype, settings);
-  return nullptr;
-}
-
 // Process a single (fmisid, utc_time) observation group: collect measurand data and emit all
 // parameters. Advances 'it' past consumed observations. Skips if ldt is not in valid_timesteps.
 void processObservationGroup(std::vector<const LocationDataItem *>::const_iterator &it,
@@ -963,24 +1058,135 @@ void processObservationGroup(std::vector<const LocationDataItem *>::const_iterat
                              int grp_fmisid,
                              const Fmi::DateTime &grp_utctime,
                              const Fmi::LocalDateTime &ldt,
+                             const Fmi::LocalDateTime &now,
                              const std::set<Fmi::LocalDateTime> &valid_timesteps,
                              bool isWeatherDataQCTable,
                              const PrecomputedParams &procParams,
                              const Spine::Station &station,
                              const std::string &stationtype,
                              const Settings &settings,
+                             GroupValues &group_data,
                              TS::TimeSeriesVectorPtr &resultVector)
 {
-  auto group_data = collectGroupData(it, end, grp_fmisid, grp_utctime, isWeatherDataQCTable);
+  collectGroupData(it, end, grp_fmisid, grp_utctime, isWeatherDataQCTable, procParams, group_data);
   if (valid_timesteps.find(ldt) == valid_timesteps.end())
     return;
   emitRegularParams(procParams, group_data, ldt, resultVector);
-  const Fmi::LocalDateTime now(Fmi::SecondClock::universal_time(), ldt.zone());
   const SpecialParameters::Args args(station, stationtype, ldt, now, settings.timezone, &settings);
   for (const auto &sp : procParams.special)
     emitSpecialParam(sp, ldt, group_data, procParams, args, settings, station, resultVector);
 }
 
+// Order of observations in buildTimeSeriesFromObservations
+bool observationLess(const LocationDataItem *a, const LocationDataItem *b)
+{
+  if (a->data.fmisid != b->data.fmisid)
+    return a->data.fmisid < b->data.fmisid;
+  return a->data.data_time < b->data.data_time;
+}
+
+// Order the observations by (fmisid, data_time). The database queries return the observations
+// sorted and the memory cache returns them as time ordered runs in station iteration order.
+// Hence we detect the ordered runs and merely reorder them when they do not overlap, and fall
+// back to a full sort only if they do.
+std::vector<const LocationDataItem *> sortObservations(const LocationDataItems &observations)
+{
+  std::vector<const LocationDataItem *> obs;
+  obs.reserve(observations.size());
+  for (const auto &item : observations)
+    obs.push_back(&item);
+
+  // Find the start positions of the ordered runs
+  std::vector<std::size_t> runs{0};
+  for (std::size_t i = 1; i < obs.size(); i++)
+    if (observationLess(obs[i], obs[i - 1]))
+      runs.push_back(i);
+
+  if (runs.size() == 1)
+    return obs;
+
+  // Order the runs by their first element and check they do not overlap
+  auto run_end = [&](std::size_t r) { return (r + 1 < runs.size() ? runs[r + 1] : obs.size()); };
+
+  std::vector<std::size_t> order(runs.size());
+  for (std::size_t r = 0; r < order.size(); r++)
+    order[r] = r;
+  std::sort(order.begin(),
+            order.end(),
+            [&](std::size_t a, std::size_t b)
+            { return observationLess(obs[runs[a]], obs[runs[b]]); });
+
+  for (std::size_t r = 1; r < order.size(); r++)
+  {
+    if (observationLess(obs[runs[order[r]]], obs[run_end(order[r - 1]) - 1]))
+    {
+      std::stable_sort(obs.begin(), obs.end(), observationLess);
+      return obs;
+    }
+  }
+
+  std::vector<const LocationDataItem *> ret;
+  ret.reserve(obs.size());
+  for (auto r : order)
+    ret.insert(ret.end(), obs.begin() + runs[r], obs.begin() + run_end(r));
+  return ret;
+}
+
+// Observations of a single station in the sorted observation vector
+struct StationObservations
+{
+  std::vector<const LocationDataItem *>::const_iterator begin;
+  std::vector<const LocationDataItem *>::const_iterator end;
+  const Spine::Station *station = nullptr;
+  const std::set<Fmi::LocalDateTime> *valid_timesteps = nullptr;
+  const std::string *tz_name = nullptr;
+};
+
+// Result columns of a single station, null if the station emitted no rows
+struct StationTimeSeries
+{
+  TS::TimeSeriesVectorPtr columns;
+};
+
+// Build the time series of a single station. Stations are independent of each other, hence
+// this may be called for different stations in parallel.
+StationTimeSeries buildStationTimeSeries(const StationObservations &obs,
+                                         LocalTimeCache &localtimes,
+                                         bool isWeatherDataQCTable,
+                                         const PrecomputedParams &procParams,
+                                         const std::map<int, std::string> &continuous,
+                                         const std::string &stationtype,
+                                         const Settings &settings)
+{
+  StationTimeSeries ret;
+  auto resultVector = initializeResultVector(settings);
+  GroupValues group_data(procParams.measurand_slots.size());
+  auto &tz = localtimes.zone(*obs.tz_name);
+  const Fmi::LocalDateTime now(Fmi::SecondClock::universal_time(), tz.tz());
+
+  auto it = obs.begin;
+  while (it != obs.end)
+  {
+    const int grp_fmisid = (*it)->data.fmisid;
+    const Fmi::DateTime grp_utctime = (*it)->data.data_time;
+
+    // Convert UTC time to LocalDateTime ONCE per (fmisid, utc_time) group, then collect and
+    // emit all parameters for this (fmisid, utc_time) group (skips if ldt not in valid set).
+    const auto ldt = tz.localTime(grp_utctime);
+    processObservationGroup(it, obs.end, grp_fmisid, grp_utctime, ldt, now,
+                            *obs.valid_timesteps, isWeatherDataQCTable, procParams,
+                            *obs.station, stationtype, settings, group_data, resultVector);
+  }
+
+  if (resultVector->empty() || resultVector->at(0).empty())
+    return ret;
+
+  ret.columns = initializeResultVector(settings);
+  fillMissingTimesteps(resultVector, ret.columns, *obs.valid_timesteps, continuous,
+                       *obs.station, stationtype, settings);
+  return ret;
+}
+
 }  // namespace
 
 void DBQueryUtils::addDependentMeasurandIds(QueryMapping &ret,
@@ -1066,6 +1272,31 @@ void DBQueryUtils::processRegularParam(const Spine::Parameter &p,
 QueryMapping DBQueryUtils::buildQueryMapping(const Settings &settings,
                                              const std::string &stationtype,
                                              bool isWeatherDataQCTable) const
+{
+  try
+  {
+    if (!query_plans_enabled)
+      return compileQueryMapping(settings, stationtype, isWeatherDataQCTable);
+
+    const auto key = query_plan_key(settings, stationtype, isWeatherDataQCTable);
+    auto &cache = query_plan_cache();
+    if (auto plan = cache.find(key))
+      return (*plan)->qmap;
+
+    auto plan = std::make_shared<QueryPlan>();
+    plan->qmap = compileQueryMapping(settings, stationtype, isWeatherDataQCTable);
+    cache.insert(key, plan);
+    return plan->qmap;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Building query mapping failed!");
+  }
+}
+
+QueryMapping DBQueryUtils::compileQueryMapping(const Settings &settings,
+                                               const std::string &stationtype,
+                                               bool isWeatherDataQCTable) const
 {
   try
   {
@@ -1126,6 +1357,50 @@ TimestepsByFMISID DBQueryUtils::getValidTimeSteps(
   return fmisid_timesteps;
 }
 
+std::mutex DBQueryUtils::theParallelPoolMutex;
+std::shared_ptr<WorkerPool> DBQueryUtils::theParallelPool;
+std::atomic<std::size_t> DBQueryUtils::theParallelMinStations{0};
+
+void DBQueryUtils::setQueryPlanCacheSize(std::size_t size)
+{
+  try
+  {
+    // Plans depend on the parameter configuration, hence (re)initialization clears them
+    query_plans_enabled = false;
+    auto &cache = query_plan_cache();
+    cache.clear();
+    if (size > 0)
+    {
+      cache.resize(size);
+      query_plans_enabled = true;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void DBQueryUtils::setParallelStationProcessing(std::size_t maxThreads, std::size_t minStations)
+{
+  try
+  {
+    // The calling thread takes part in the work, hence one thread less in the pool. Queries
+    // still running with the previous pool keep it alive until they finish.
+    std::shared_ptr<WorkerPool> pool;
+    if (maxThreads > 1)
+      pool = std::make_shared<WorkerPool>(maxThreads - 1);
+
+    std::lock_guard<std::mutex> lock(theParallelPoolMutex);
+    theParallelPool = pool;
+    theParallelMinStations = minStations;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 void DBQueryUtils::setAdditionalTimestepOption(AdditionalTimestepOption opt)
 {
   itsGetRequestedAndDataTimesteps = opt;
@@ -1160,8 +1435,9 @@ std::set<int> DBQueryUtils::buildStationList(const Spine::Stations &stations,
   try
   {
     std::set<int> station_ids;
+    const auto groupmask = stationInfo.groupMask(stationgroup_codes);
     for (const Spine::Station &s : stations)
-      if (stationInfo.belongsToGroup(s.fmisid, stationgroup_codes))
+      if (stationInfo.belongsToGroup(s.fmisid, groupmask))
         station_ids.insert(s.fmisid);
 
     check_request_limit(requestLimits, station_ids.size(), TS::RequestLimitMember::LOCATIONS);
@@ -1236,99 +1512,123 @@ TS::TimeSeriesVectorPtr DBQueryUtils::buildTimeSeriesFromObservations(
     if (observations.empty())
       return initializeResultVector(settings);
 
-    // Pre-compute parameter processing info once per request (avoids per-observation string lookups)
-    const auto procParams = buildPrecomputedParams(qmap, stationtype, itsParameterMap);
-    const auto continuous = buildContinuousParameterMap(qmap);
-
-    // Sort by (fmisid, data_time) using fast integer/ptime comparison instead of LocalDateTime
-    std::vector<const LocationDataItem *> sorted_obs;
-    sorted_obs.reserve(observations.size());
-    for (const auto &obs : observations)
-      sorted_obs.push_back(&obs);
-    std::sort(sorted_obs.begin(),
-              sorted_obs.end(),
-              [](const LocationDataItem *a, const LocationDataItem *b)
-              {
-                if (a->data.fmisid != b->data.fmisid)
-                  return a->data.fmisid < b->data.fmisid;
-                return a->data.data_time < b->data.data_time;
-              });
+    // Pre-compute parameter processing info once per query plan (avoids per-observation string
+    // lookups). The plan was cached by buildQueryMapping for the same query.
+    QueryPlanPtr plan;
+    if (query_plans_enabled)
+    {
+      if (auto cached = query_plan_cache().find(
+              query_plan_key(settings, stationtype, isWeatherDataQCTable)))
+        plan = *cached;
+    }
+    if (!plan)
+    {
+      plan = std::make_shared<QueryPlan>();
+      plan->qmap = qmap;
+    }
+    std::call_once(plan->precomputed,
+                   [&]()
+                   {
+                     plan->procParams =
+                         buildPrecomputedParams(plan->qmap, stationtype, itsParameterMap);
+                     plan->continuous = buildContinuousParameterMap(plan->qmap);
+                   });
+    const auto &procParams = plan->procParams;
+    const auto &continuous = plan->continuous;
+
+    // Order by (fmisid, data_time). The readers return the data as ordered per-station runs,
+    // hence a full sort is seldom needed.
+    const auto sorted_obs = sortObservations(observations);
 
     // Compute valid timestep sets from sorted data (first pass, UTC comparisons only)
     const auto fmisid_valid_timesteps = computeValidTimestepsSorted(
         sorted_obs, settings, timeSeriesOptions, timezones, fmisid_to_station,
         itsGetRequestedAndDataTimesteps);
 
-    auto timeSeriesColumns = initializeResultVector(settings);
-    auto resultVector = initializeResultVector(settings);
-
-    // Track current timezone lazily (only updated on fmisid change)
-    auto current_tz_name = settings.timezone;
-    auto current_tz = timezones.time_zone_from_string(current_tz_name);
-    int current_fmisid = -1;
-    const Spine::Station *current_station = nullptr;
+    // Observation ranges of the stations to process, in station order
+    std::vector<StationObservations> stations;
 
     auto it = sorted_obs.cbegin();
     while (it != sorted_obs.cend())
     {
-      const int grp_fmisid = (*it)->data.fmisid;
-      const Fmi::DateTime grp_utctime = (*it)->data.data_time;
+      const int fmisid = (*it)->data.fmisid;
+      const auto begin = it;
+      skipFmisidGroup(it, sorted_obs.cend(), fmisid);
 
-      // Handle station change
-      if (grp_fmisid != current_fmisid)
-      {
-        // Finalize the previous station's time series
-        if (auto result = tryFinalizeStation(current_fmisid, fmisid_valid_timesteps, continuous,
-                                             current_station, stationtype, settings,
-                                             resultVector, timeSeriesColumns))
-          return result;
-
-        // Skip stations not in fmisid_to_station (unknown stations)
-        if (fmisid_to_station.find(grp_fmisid) == fmisid_to_station.end())
-        {
-          skipFmisidGroup(it, sorted_obs.cend(), grp_fmisid);
-          current_fmisid = grp_fmisid;
-          current_station = nullptr;
-          continue;
-        }
+      // Skip unknown stations and stations without valid timesteps
+      const auto station_it = fmisid_to_station.find(fmisid);
+      if (station_it == fmisid_to_station.end())
+        continue;
+      const auto ts_it = fmisid_valid_timesteps.find(fmisid);
+      if (ts_it == fmisid_valid_timesteps.end())
+        continue;
 
-        current_fmisid = grp_fmisid;
-        current_station = &fmisid_to_station.at(grp_fmisid);
+      const auto *tz_name = (settings.timezone == "localtime" ? &station_it->second.timezone
+                                                              : &settings.timezone);
+      stations.push_back(
+          StationObservations{begin, it, &station_it->second, &ts_it->second, tz_name});
+    }
 
-        // Update timezone for new station (same lazy logic as buildStationTimedMeasurandData)
-        if (settings.timezone == "localtime" && current_station->timezone != current_tz_name)
-        {
-          current_tz_name = current_station->timezone;
-          current_tz = timezones.time_zone_from_string(current_tz_name);
-        }
-      }
+    std::vector<StationTimeSeries> results(stations.size());
 
-      if (!current_station)
+    auto build = [&](std::size_t first, std::size_t last)
+    {
+      LocalTimeCache localtimes(timezones);
+      for (std::size_t i = first; i < last; i++)
       {
-        ++it;
-        continue;
+        checkCancellation(settings.cancellation);
+        results[i] = buildStationTimeSeries(stations[i], localtimes, isWeatherDataQCTable,
+                                            procParams, continuous, stationtype, settings);
       }
+    };
 
-      const auto ts_it = fmisid_valid_timesteps.find(grp_fmisid);
-      if (ts_it == fmisid_valid_timesteps.end())
+    std::shared_ptr<WorkerPool> pool;
+    {
+      std::lock_guard<std::mutex> lock(theParallelPoolMutex);
+      pool = theParallelPool;
+    }
+
+    if (pool && stations.size() >= std::max<std::size_t>(2, theParallelMinStations))
+    {
+      // Split the stations into contiguous chunks of roughly equal number of observations
+      const std::size_t nchunks = std::min(pool->size() + 1, stations.size());
+      const std::size_t chunk_obs = (sorted_obs.size() + nchunks - 1) / nchunks;
+
+      std::vector<std::pair<std::size_t, std::size_t>> chunks;
+      std::size_t first = 0;
+      std::size_t nobs = 0;
+      for (std::size_t i = 0; i < stations.size(); i++)
       {
-        skipFmisidGroup(it, sorted_obs.cend(), grp_fmisid);
-        continue;
+        nobs += static_cast<std::size_t>(stations[i].end - stations[i].begin);
+        if (nobs >= chunk_obs || i + 1 == stations.size())
+        {
+          chunks.emplace_back(first, i + 1);
+          first = i + 1;
+          nobs = 0;
+        }
       }
 
-      // Convert UTC time to LocalDateTime ONCE per (fmisid, utc_time) group, then collect and
-      // emit all parameters for this (fmisid, utc_time) group (skips if ldt not in valid set).
-      const Fmi::LocalDateTime ldt(grp_utctime, current_tz);
-      processObservationGroup(it, sorted_obs.cend(), grp_fmisid, grp_utctime, ldt,
-                              ts_it->second, isWeatherDataQCTable, procParams,
-                              *current_station, stationtype, settings, resultVector);
+      pool->run(chunks.size(), [&](std::size_t c) { build(chunks[c].first, chunks[c].second); });
     }
+    else
+      build(0, stations.size());
 
-    // Finalize the last station
-    if (auto result = tryFinalizeStation(current_fmisid, fmisid_valid_timesteps, continuous,
-                                         current_station, stationtype, settings,
-                                         resultVector, timeSeriesColumns))
-      return result;
+    // Concatenate the stations in order. As before, a station with no emitted rows ends the
+    // result.
+    auto timeSeriesColumns = initializeResultVector(settings);
+    for (auto &result : results)
+    {
+      if (!result.columns)
+        break;
+      for (std::size_t i = 0; i < timeSeriesColumns->size(); i++)
+      {
+        auto &src = result.columns->at(i);
+        auto &dst = timeSeriesColumns->at(i);
+        dst.insert(
+            dst.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+      }
+      result.columns.reset();
+    }
 
     return timeSeriesColumns;
   }
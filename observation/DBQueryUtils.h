@@ -7,6 +7,9 @@
 #include "StationInfo.h"
 #include <macgyver/TimeZones.h>
 #include <timeseries/TimeSeriesInclude.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 namespace SmartMet
 {
@@ -14,6 +17,8 @@ namespace Engine
 {
 namespace Observation
 {
+class WorkerPool;
+
 using StationMap = std::map<int, Spine::Station>;
 using TimestepsByFMISID = std::map<int, std::set<Fmi::LocalDateTime>>;
 enum class AdditionalTimestepOption
@@ -32,12 +37,23 @@ class DBQueryUtils
   // aggregation) but wms, wfs must have only requested timesteps
   void setAdditionalTimestepOption(AdditionalTimestepOption opt);
 
+  // Process-wide setting for building the time series of different stations in parallel.
+  // A query uses its own thread and the maxThreads-1 worker threads shared by all queries.
+  // maxThreads <= 1 disables parallel processing, minStations is the smallest number of
+  // stations for which the work is split.
+  static void setParallelStationProcessing(std::size_t maxThreads, std::size_t minStations);
+
+  // Process-wide LRU cache of compiled query mappings keyed by stationtype and parameter list.
+  // Zero disables the cache. Setting the size also clears the cache.
+  static void setQueryPlanCacheSize(std::size_t size);
+
   const ParameterMapPtr &getParameterMap() const { return itsParameterMap; }
 
   void setDebug(bool state) { itsDebug = state; }
   bool getDebug() const { return itsDebug; }
 
  protected:
+  // Returns the cached mapping if there is one
   virtual QueryMapping buildQueryMapping(const Settings &settings,
                                          const std::string &stationtype,
                                          bool isWeatherDataQCTable) const;
@@ -82,12 +98,20 @@ class DBQueryUtils
   AdditionalTimestepOption itsGetRequestedAndDataTimesteps{
       AdditionalTimestepOption::RequestedAndDataTimesteps};
 
+  static std::mutex theParallelPoolMutex;
+  static std::shared_ptr<WorkerPool> theParallelPool;
+  static std::atomic<std::size_t> theParallelMinStations;
+
   // Adds the measurand IDs that computed special parameters (feelslike, windcompass, etc.)
   // depend on, so they are fetched from the database. No-op for QC table (IDs are different).
   void addDependentMeasurandIds(QueryMapping &ret,
                                 const std::string &name,
                                 const std::string &stationtype) const;
 
+  QueryMapping compileQueryMapping(const Settings &settings,
+                                  const std::string &stationtype,
+                                  bool isWeatherDataQCTable) const;
+
   // Processes a single regular (non-special) parameter in buildQueryMapping.
   void processRegularParam(const Spine::Parameter &p,
                            std::string name,  // by value: removePrefix mutates it
@@ -0,0 +1,190 @@
+#include "DataCoverage.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+void DataCoverage::extend(Measurands& measurands,
+                          int measurand_id,
+                          const Fmi::DateTime& first,
+                          const Fmi::DateTime& last)
+{
+  auto pos = measurands.find(measurand_id);
+  if (pos == measurands.end())
+    measurands.emplace(measurand_id, Span{first, last});
+  else
+  {
+    pos->second.first = std::min(pos->second.first, first);
+    pos->second.last = std::max(pos->second.last, last);
+  }
+}
+
+void DataCoverage::add(const DataItems& items)
+{
+  try
+  {
+    Spine::WriteLock lock(itsMutex);
+
+    // The items are mostly sorted by station, avoid looking up the station for each item
+    Measurands* measurands = nullptr;
+    int fmisid = 0;
+
+    for (const auto& item : items)
+    {
+      if (measurands == nullptr || item.fmisid != fmisid)
+      {
+        fmisid = item.fmisid;
+        measurands = &itsCoverage[fmisid];
+      }
+      extend(*measurands, item.measurand_id, item.data_time, item.data_time);
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void DataCoverage::add(int fmisid,
+                       int measurand_id,
+                       const Fmi::DateTime& first,
+                       const Fmi::DateTime& last)
+{
+  try
+  {
+    Spine::WriteLock lock(itsMutex);
+    extend(itsCoverage[fmisid], measurand_id, first, last);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void DataCoverage::clean(const Fmi::DateTime& starttime)
+{
+  try
+  {
+    Spine::WriteLock lock(itsMutex);
+
+    for (auto station = itsCoverage.begin(); station != itsCoverage.end();)
+    {
+      auto& measurands = station->second;
+      for (auto pos = measurands.begin(); pos != measurands.end();)
+      {
+        if (pos->second.last < starttime)
+          pos = measurands.erase(pos);
+        else
+        {
+          pos->second.first = std::max(pos->second.first, starttime);
+          ++pos;
+        }
+      }
+
+      if (measurands.empty())
+        station = itsCoverage.erase(station);
+      else
+        ++station;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::set<int> DataCoverage::stationsWithData(const std::vector<int>& fmisids,
+                                             const std::vector<int>& measurand_ids,
+                                             const Fmi::DateTime& starttime,
+                                             const Fmi::DateTime& endtime) const
+{
+  try
+  {
+    if (!itsComplete)
+      return {fmisids.begin(), fmisids.end()};
+
+    std::set<int> ret;
+
+    Spine::ReadLock lock(itsMutex);
+    for (auto fmisid : fmisids)
+    {
+      auto station = itsCoverage.find(fmisid);
+      if (station == itsCoverage.end())
+        continue;
+
+      for (auto measurand_id : measurand_ids)
+      {
+        auto pos = station->second.find(measurand_id);
+        if (pos != station->second.end() && pos->second.first <= endtime &&
+            pos->second.last >= starttime)
+        {
+          ret.insert(fmisid);
+          break;
+        }
+      }
+    }
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void DataCoverage::prune(Spine::Stations& stations,
+                         std::vector<int>& measurand_ids,
+                         const Fmi::DateTime& starttime,
+                         const Fmi::DateTime& endtime) const
+{
+  try
+  {
+    if (!itsComplete)
+      return;
+
+    std::set<int> found_measurands;
+    Spine::Stations found_stations;
+
+    Spine::ReadLock lock(itsMutex);
+    for (const auto& station : stations)
+    {
+      auto coverage = itsCoverage.find(station.fmisid);
+      if (coverage == itsCoverage.end())
+        continue;
+
+      bool found = false;
+      for (auto measurand_id : measurand_ids)
+      {
+        auto pos = coverage->second.find(measurand_id);
+        if (pos != coverage->second.end() && pos->second.first <= endtime &&
+            pos->second.last >= starttime)
+        {
+          found = true;
+          found_measurands.insert(measurand_id);
+        }
+      }
+
+      if (found)
+        found_stations.push_back(station);
+    }
+
+    stations = std::move(found_stations);
+    measurand_ids.erase(std::remove_if(measurand_ids.begin(),
+                                       measurand_ids.end(),
+                                       [&found_measurands](int id)
+                                       { return found_measurands.count(id) == 0; }),
+                        measurand_ids.end());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
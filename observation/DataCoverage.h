@@ -0,0 +1,70 @@
+#pragma once
+
+#include "DataItem.h"
+#include <macgyver/DateTime.h>
+#include <spine/Station.h>
+#include <spine/Thread.h>
+#include <atomic>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Time span of the cached observations of each station and measurand. Used to drop stations
+// and measurands which have no data in the query interval before the query is built. The
+// coverage may claim data which is not there, but never the other way around. Until the
+// coverage has been initialized from the cache contents it claims everything is available.
+
+class DataCoverage
+{
+ public:
+  // Extend the coverage with new observations
+  void add(const DataItems& items);
+  void add(int fmisid, int measurand_id, const Fmi::DateTime& first, const Fmi::DateTime& last);
+
+  // Forget observations older than the given time
+  void clean(const Fmi::DateTime& starttime);
+
+  // Mark the coverage to be initialized from the full cache contents
+  void setComplete() { itsComplete = true; }
+  bool complete() const { return itsComplete; }
+
+  // The fmisids which have data for at least one of the measurands in the interval
+  std::set<int> stationsWithData(const std::vector<int>& fmisids,
+                                 const std::vector<int>& measurand_ids,
+                                 const Fmi::DateTime& starttime,
+                                 const Fmi::DateTime& endtime) const;
+
+  // Remove stations and measurands which have no data in the interval
+  void prune(Spine::Stations& stations,
+             std::vector<int>& measurand_ids,
+             const Fmi::DateTime& starttime,
+             const Fmi::DateTime& endtime) const;
+
+ private:
+  struct Span
+  {
+    Fmi::DateTime first;
+    Fmi::DateTime last;
+  };
+
+  using Measurands = std::map<int, Span>;  // measurand_id
+
+  static void extend(Measurands& measurands,
+                     int measurand_id,
+                     const Fmi::DateTime& first,
+                     const Fmi::DateTime& last);
+
+  std::atomic<bool> itsComplete{false};
+  mutable Spine::MutexType itsMutex;
+  std::map<int, Measurands> itsCoverage;  // fmisid
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -108,6 +108,10 @@ void DatabaseDriverBase::readConfig(Spine::ConfigBase& cfg, DatabaseDriverParame
         "flashCacheUpdateInterval", parameters.flashCacheUpdateInterval);
     parameters.stationsCacheUpdateInterval = driverInfo.getIntParameterValue(
         "stationsCacheUpdateInterval", parameters.stationsCacheUpdateInterval);
+    parameters.stationsFullReloadInterval = driverInfo.getIntParameterValue(
+        "stationsFullReloadInterval", parameters.stationsFullReloadInterval);
+    parameters.stationsGeonamesCacheMaxAge = driverInfo.getIntParameterValue(
+        "stationsGeonamesCacheMaxAge", parameters.stationsGeonamesCacheMaxAge);
     parameters.magnetometerCacheUpdateInterval = driverInfo.getIntParameterValue(
         "magnetometerCacheUpdateInterval", parameters.magnetometerCacheUpdateInterval);
 
@@ -18,6 +18,30 @@ namespace
 const DatabaseDriverInfoItem emptyDriverInfoItem;
 const CacheInfoItem emptyCacheInfoItem;
 
+/*!
+ * \brief Read the optional connection priority class limits of a driver
+ *
+ * connectionPriorities:
+ * {
+ *   cache_update: { reserved = 2; maxPercentage = 50; };
+ *   interactive:  { reserved = 4; };
+ * };
+ */
+
+void readConnectionPriorities(Spine::ConfigBase& cfg,
+                              const std::string& common_key,
+                              std::map<std::string, std::string>& params)
+{
+  for (const std::string name : {"interactive", "cache_update", "admin"})
+  {
+    const std::string key = common_key + ".connectionPriorities." + name;
+    params["priority_" + name + "_reserved"] =
+        Fmi::to_string(cfg.get_optional_config_param<int>(key + ".reserved", 0));
+    params["priority_" + name + "_max_percentage"] =
+        Fmi::to_string(cfg.get_optional_config_param<int>(key + ".maxPercentage", 100));
+  }
+}
+
 /*!
  * \brief Lookup configuration value for the database considering overrides
  */
@@ -165,6 +189,14 @@ void readPostgreSQLCommonInfo(Spine::ConfigBase& cfg,
 
     params["stationsCacheUpdateInterval"] = Fmi::to_string(
         cfg.get_optional_config_param<std::size_t>(common_key + ".stationsCacheUpdateInterval", 0));
+    params["stationsFullReloadInterval"] =
+        Fmi::to_string(cfg.get_optional_config_param<std::size_t>(
+            common_key + ".stationsFullReloadInterval", 86400));
+    params["stationsGeonamesCacheMaxAge"] =
+        Fmi::to_string(cfg.get_optional_config_param<std::size_t>(
+            common_key + ".stationsGeonamesCacheMaxAge", 604800));
+
+    readConnectionPriorities(cfg, common_key, params);
   }
 
   params["flash_emulator_active"] = "false";
@@ -280,6 +312,8 @@ void readPostgreSQLMobileCommonInfo(Spine::ConfigBase& cfg,
       Fmi::to_string(cfg.get_optional_config_param<int>(common_key + ".fmiIoTCacheDuration", 0));
   params["tapsiQcCacheDuration"] =
       Fmi::to_string(cfg.get_optional_config_param<int>(common_key + ".tapsiQcCacheDuration", 0));
+
+  readConnectionPriorities(cfg, common_key, params);
 }
 
 void readFakeCacheInfo(Spine::ConfigBase& cfg,
@@ -36,6 +36,8 @@ struct DatabaseDriverParameters
   std::size_t tapsiQcCacheUpdateInterval = 0;
   std::size_t magnetometerCacheUpdateInterval = 0;
   std::size_t stationsCacheUpdateInterval = 0;
+  std::size_t stationsFullReloadInterval = 86400;  // seconds between full station reloads
+  std::size_t stationsGeonamesCacheMaxAge = 604800;  // seconds, 0 = never expire
   int updateExtraInterval = 10;  // update 10 seconds before max(modified_last) for safety
   int finCacheDuration = 0;
   int finMemoryCacheDuration = 0;
@@ -101,15 +101,15 @@ Spine::Stations DatabaseStations::cachedFindNearestStations(
     const Fmi::DateTime& endtime) const
 {
   // The cached candidate lists hold StationID indices that are only valid for
-  // the StationInfo instance that produced them. Clear the cache if the station
-  // data has been swapped underneath us. Holding a shared_ptr to the instance
-  // also prevents its address from being reused while the cache refers to it.
+  // StationInfo instances of the same layout. Clear the cache if the station
+  // data has been swapped underneath us by one with a different layout. Patched
+  // instances which keep the StationIDs and coordinates share the cache.
   {
     std::lock_guard<std::mutex> lock(itsCacheMutex);
-    if (itsCacheStationInfo != info)
+    if (itsCacheLayout != info->layout())
     {
       itsNearestCandidateCache.clear();
-      itsCacheStationInfo = info;
+      itsCacheLayout = info->layout();
     }
   }
 
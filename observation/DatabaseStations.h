@@ -6,6 +6,7 @@
 #include <engines/geonames/Engine.h>
 #include <macgyver/Cache.h>
 #include <spine/Location.h>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -56,8 +57,8 @@ class DatabaseStations
   // Cached nearest-station search. Caches the time- and group-independent
   // geometric candidate list keyed on coordinates and maxdistance, then applies
   // the time and group filtering per request. The candidate lists reference
-  // StationID indices of a particular StationInfo instance, so the cache is
-  // cleared whenever the station data is swapped underneath us.
+  // StationID indices of a particular StationInfo layout, so the cache is
+  // cleared whenever the station data is swapped for one with another layout.
   Spine::Stations cachedFindNearestStations(const std::shared_ptr<StationInfo>& info,
                                             double longitude,
                                             double latitude,
@@ -76,10 +77,10 @@ class DatabaseStations
   // (geoid,language) --> resolved locations (Locus idSearch results)
   mutable Fmi::Cache::Cache<std::string, Spine::LocationList> itsGeoIdCache;
 
-  // Guards the identity check that ties itsNearestCandidateCache to the current
-  // StationInfo instance.
+  // Guards the layout check that ties itsNearestCandidateCache to the current
+  // StationInfo layout.
   mutable std::mutex itsCacheMutex;
-  mutable std::shared_ptr<StationInfo> itsCacheStationInfo;
+  mutable std::uint64_t itsCacheLayout = 0;
 };
 
 }  // namespace Observation
@@ -29,6 +29,16 @@ TS::TimeSeriesVectorPtr DisabledEngine::values(
   return {};
 }
 
+std::vector<TS::TimeSeriesVectorPtr> DisabledEngine::values(std::vector<Settings>& settings)
+{
+  return std::vector<TS::TimeSeriesVectorPtr>(settings.size());
+}
+
+void DisabledEngine::visitValues(Settings& /* settings */,
+                                 const StationValuesVisitor& /* visitor */)
+{
+}
+
 void DisabledEngine::makeQuery(QueryBase* qb)
 {
   (void)qb;
@@ -17,6 +17,8 @@ class DisabledEngine : public Engine
   TS::TimeSeriesVectorPtr values(Settings &settings) override;
   TS::TimeSeriesVectorPtr values(Settings &settings,
                                  const TS::TimeSeriesGeneratorOptions &timeSeriesOptions) override;
+  std::vector<TS::TimeSeriesVectorPtr> values(std::vector<Settings> &settings) override;
+  void visitValues(Settings &settings, const StationValuesVisitor &visitor) override;
 
   void makeQuery(QueryBase *qb) override;
 
@@ -8,6 +8,7 @@
 #include "StationSettings.h"
 #include <spine/Table.h>
 #include <spine/TableFormatter.h>
+#include <functional>
 
 namespace SmartMet
 {
@@ -20,6 +21,9 @@ using ContentTable = std::unique_ptr<Spine::Table>;
 class DBRegistry;
 class QueryBase;
 
+// Receives the result of one station, the data is valid only during the call
+using StationValuesVisitor = std::function<void(const TS::TimeSeriesVector &stationValues)>;
+
 class Engine : public SmartMet::Spine::SmartMetEngine
 {
  protected:
@@ -34,6 +38,24 @@ class Engine : public SmartMet::Spine::SmartMetEngine
   virtual TS::TimeSeriesVectorPtr values(Settings &settings,
                                          const TS::TimeSeriesGeneratorOptions &timeSeriesOptions) = 0;
 
+  /* \brief Run several queries in one call
+   * \param[in] settings Settings of the queries
+   * \return One result per input settings, in the same order
+   *
+   * Queries which differ only by their FMISID lists are run as a single query.
+   */
+  virtual std::vector<TS::TimeSeriesVectorPtr> values(std::vector<Settings> &settings) = 0;
+
+  /* \brief Run a query passing the result to the visitor one station at a time
+   * \param[in] settings Settings of the query
+   * \param[in] visitor Called with the parameter columns of each station in turn
+   *
+   * Stations given as FMISIDs are queried in chunks, which keeps the peak memory use
+   * bounded for queries covering a large number of stations. Other queries are run as
+   * a whole, and only save the memory of a second copy of the result.
+   */
+  virtual void visitValues(Settings &settings, const StationValuesVisitor &visitor) = 0;
+
   virtual void makeQuery(QueryBase *qb) = 0;
 
   virtual FlashCounts getFlashCount(const Fmi::DateTime &starttime,
@@ -1,5 +1,7 @@
 #include "EngineImpl.h"
+#include "DBQueryUtils.h"
 #include "DBRegistry.h"
+#include "DatabaseDriverBase.h"
 #include "DatabaseDriverFactory.h"
 #include "ObservationCacheFactory.h"
 #include "SpecialParameters.h"
@@ -8,6 +10,7 @@
 #include <boost/make_shared.hpp>
 #include <fmt/format.h>
 #include <macgyver/Geometry.h>
+#include <macgyver/Hash.h>
 #include <macgyver/Join.h>
 #include <macgyver/StringConversion.h>
 #include <macgyver/TypeName.h>
@@ -16,7 +19,12 @@
 #include <spine/Reactor.h>
 #include <timeseries/ParameterTools.h>
 #include <timeseries/TimeSeriesInclude.h>
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <set>
+#include <sstream>
+#include <unordered_map>
 
 namespace SmartMet
 {
@@ -121,63 +129,65 @@ void afterQuery(TS::TimeSeriesVectorPtr &tsvPtr,
     if (fmisid_index < 0 || settings.taggedFMISIDs.empty())
       return;
 
-    const TS::TimeSeries &fmisid_vector = tsvPtr->at(fmisid_index);
-    std::map<std::string, std::vector<int>> fmisid_mapped_indexes;
-    // Sort out data indexes per each FMISID
-    for (unsigned int i = 0; i < fmisid_vector.size(); i++)
+    // Row ranges of each station. Usually each station has a single contiguous range.
+    struct StationRanges
     {
-      const TS::Value &value = fmisid_vector.at(i).value;
-      std::string fmisid = getStringValue(value);
-      fmisid_mapped_indexes[fmisid].push_back(i);
+      std::vector<StationRows> ranges;
+      std::size_t uses = 0;  // number of times requested in taggedFMISIDs
+    };
+    std::unordered_map<std::string, StationRanges> station_ranges;
+    for (auto &range : stationRowRanges(tsvPtr->at(fmisid_index)))
+      station_ranges[range.fmisid].ranges.push_back(range);
+
+    std::vector<StationRanges *> requested;
+    requested.reserve(settings.taggedFMISIDs.size());
+    for (const auto &id : settings.taggedFMISIDs)
+    {
+      auto pos = station_ranges.find(Fmi::to_string(id.fmisid));
+      if (pos == station_ranges.end())
+        continue;
+      ++pos->second.uses;
+      requested.push_back(&pos->second);
     }
 
     // Create and initialize data structure for results
-    TS::TimeSeriesVectorPtr result = std::make_shared<TS::TimeSeriesVector>();
-    for (unsigned int i = 0; i < tsvPtr->size(); i++)
-      result->emplace_back();
+    TS::TimeSeriesVectorPtr result = std::make_shared<TS::TimeSeriesVector>(tsvPtr->size());
 
-    // FMISIDs are in right order in settings.taggedFMISIDs list
-    // Iterate the list and copy data from original data structure to result structure
-    for (const auto &id : settings.taggedFMISIDs)
+    // FMISIDs are in right order in settings.taggedFMISIDs list. Move the rows of each station
+    // to the result, or copy them if the station is requested again later.
+    for (auto *station : requested)
     {
-      std::string fmisid = Fmi::to_string(id.fmisid);
-      if (fmisid_mapped_indexes.find(fmisid) == fmisid_mapped_indexes.end())
-        continue;
-      const auto &indexes = fmisid_mapped_indexes.at(fmisid);
-      if (indexes.empty())
-        continue;
-      unsigned int firstIndex = indexes.front();
-      unsigned int numberOfRows = indexes.size();
+      const bool last_use = (--station->uses == 0);
 
       for (unsigned int i = 0; i < tsvPtr->size(); i++)
       {
-        const TS::TimeSeries &ts = tsvPtr->at(i);
-
+        TS::TimeSeries &ts = tsvPtr->at(i);
         TS::TimeSeries &resultVector = result->at(i);
 
-        // Prevent referencing past the end of source data
-
-        if (firstIndex + numberOfRows > ts.size())
+        for (const auto &range : station->ranges)
         {
-          std::cout << "obsengine afterQuery: indexing error: fmisid=" << fmisid
-                    << " firstIndex=" << firstIndex << " numberOfRows=" << numberOfRows
-                    << " ts.size()=" << ts.size() << " settings=" << settings
-                    << " resultVector=" << resultVector << " ts=" << ts << " i=" << i
-                    << " tsvPtr->size()=" << tsvPtr->size();
+          // Prevent referencing past the end of source data
+          if (range.end > ts.size())
+          {
+            std::cout << "obsengine afterQuery: indexing error: fmisid=" << range.fmisid
+                      << " firstIndex=" << range.begin
+                      << " numberOfRows=" << (range.end - range.begin)
+                      << " ts.size()=" << ts.size() << " settings=" << settings
+                      << " resultVector=" << resultVector << " ts=" << ts << " i=" << i
+                      << " tsvPtr->size()=" << tsvPtr->size();
+
+            throw Fmi::Exception::Trace(BCP, "Internal error indexing data");
+          }
 
-          throw Fmi::Exception::Trace(BCP, "Internal error indexing data");
+          auto it_first = ts.begin() + range.begin;
+          auto it_last = ts.begin() + range.end;
+          if (last_use)
+            resultVector.insert(resultVector.end(),
+                                std::make_move_iterator(it_first),
+                                std::make_move_iterator(it_last));
+          else
+            resultVector.insert(resultVector.end(), it_first, it_last);
         }
-
-        auto it_first = ts.begin();
-        for (unsigned int k = 0; k < firstIndex; k++)
-          it_first++;
-        auto it_last = it_first;
-        for (unsigned int k = 0; k < numberOfRows; k++)
-          it_last++;
-
-        //      resultVector.insert(resultVector.end(), ts.begin() + firstIndex, ts.begin() +
-        //      firstIndex + numberOfRows);
-        resultVector.insert(resultVector.end(), it_first, it_last);
       }
     }
 
@@ -189,6 +199,33 @@ void afterQuery(TS::TimeSeriesVectorPtr &tsvPtr,
   }
 }
 
+// Check the time step and element limits of a query extracted from a merged query
+void checkMergedLimits(const TS::TimeSeriesVector &tsv, const TS::RequestLimits &limits)
+{
+  if (tsv.empty())
+    return;
+
+  if (limits.maxtimes > 0)
+  {
+    std::set<Fmi::DateTime> times;
+    for (const auto &value : tsv.front())
+      times.insert(value.time.utc_time());
+    TS::check_request_limit(limits, times.size(), TS::RequestLimitMember::TIMESTEPS);
+  }
+
+  TS::check_request_limit(
+      limits, tsv.size() * tsv.front().size(), TS::RequestLimitMember::ELEMENTS);
+}
+
+// Key of the time series options for sharing results. The printed options identify the
+// generated times, the hash covers the data times which are not printed.
+std::string optionsKey(const TS::TimeSeriesGeneratorOptions &options)
+{
+  std::ostringstream out;
+  out << options << '|' << options.hash_value();
+  return out.str();
+}
+
 }  // namespace
 
 EngineImpl::EngineImpl(std::string configfile)
@@ -204,6 +241,11 @@ void EngineImpl::init()
 
     itsEngineParameters = std::make_shared<EngineParameters>(cfg);
 
+    DBQueryUtils::setParallelStationProcessing(itsEngineParameters->timeseriesBuildThreads,
+                                               itsEngineParameters->timeseriesBuildMinStations);
+    DBQueryUtils::setQueryPlanCacheSize(itsEngineParameters->queryPlanCacheSize);
+    itsQueryAdmission = std::make_unique<QueryAdmission>(itsEngineParameters->queryAdmission);
+
     //    std::cout << itsEngineParameters->databaseDriverInfo << '\n';
 
     itsDatabaseRegistry->loadConfigurations(itsEngineParameters->dbRegistryFolderPath);
@@ -383,9 +425,14 @@ void EngineImpl::unserializeStations()
       stationinfo->unserialize(itsEngineParameters->serializedStationsFile);
 
       itsEngineParameters->stationInfo.store(stationinfo);
-      logMessage(
-          "[Observation EngineImpl] Unserialized stations successfully from " + path.string(),
-          itsEngineParameters->quiet);
+      if (stationinfo->stations.empty())
+        logMessage("[Observation EngineImpl] Ignored incompatible serialized stations in " +
+                       path.string(),
+                   itsEngineParameters->quiet);
+      else
+        logMessage(
+            "[Observation EngineImpl] Unserialized stations successfully from " + path.string(),
+            itsEngineParameters->quiet);
     }
     else
     {
@@ -423,6 +470,8 @@ void EngineImpl::initializeCache()
   try
   {
     itsEngineParameters->queryResultBaseCache.resize(itsEngineParameters->queryResultBaseCacheSize);
+    if (itsEngineParameters->valuesResultCacheSize > 0)
+      itsValuesResultCache.resize(itsEngineParameters->valuesResultCacheSize);
   }
   catch (...)
   {
@@ -482,13 +531,114 @@ TS::TimeSeriesVectorPtr EngineImpl::values(Settings &settings)
     {
       std::cout << "EngineImpl::Observation::Settings:\n" << settings << '\n';
     }
-    Settings querySettings = beforeQuery(settings, unknownParameterIndexes);
 
-    TS::TimeSeriesVectorPtr ret = itsDatabaseDriver->values(querySettings);
+    auto query = [&]()
+    {
+      checkCancellation(settings.cancellation);
+
+      Settings querySettings = beforeQuery(settings, unknownParameterIndexes);
+
+      TS::TimeSeriesVectorPtr ret = admittedValues(
+          querySettings, nullptr, [&]() { return itsDatabaseDriver->values(querySettings); });
+
+      // Insert missing values for unknown parameters and
+      // arrange data order in result set
+      afterQuery(ret, settings, unknownParameterIndexes);
+
+      return ret;
+    };
+
+    return sharedValues(settings, "", query);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Key identifying identical values() queries, or empty if the query may not be shared
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::string> EngineImpl::valuesQueryKey(const Settings &settings) const
+{
+  try
+  {
+    // Mobile and external producers may use data filters not included in the hash
+    if (itsEngineParameters->isExternalOrMobileProducer(settings.stationtype))
+      return {};
+
+    const std::string tablename = DatabaseDriverBase::resolveDatabaseTableName(
+        settings.stationtype, itsEngineParameters->stationtypeConfig);
+    if (tablename.empty())
+      return {};
+
+    return settings.key() + '|' + tablename;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a values() query sharing the result with identical queries
+ *
+ * The result is taken from the result cache if possible. Otherwise identical
+ * concurrent queries are coalesced into a single execution. Callers may modify
+ * the result, hence shared results are always copied.
+ */
+// ----------------------------------------------------------------------
+
+TS::TimeSeriesVectorPtr EngineImpl::sharedValues(
+    const Settings &settings,
+    const std::string &optionsKey,
+    const std::function<TS::TimeSeriesVectorPtr()> &query)
+{
+  try
+  {
+    auto queryKey = valuesQueryKey(settings);
+    if (!queryKey)
+      return query();
+
+    *queryKey += '|';
+    *queryKey += optionsKey;
+
+    // The result cache key includes the generation of the table and the age bucket of the
+    // query, so that entries become unreachable when new data has been written into the
+    // table or when the maximum age is exceeded.
+
+    std::optional<std::string> resultKey;
+    if (itsEngineParameters->valuesResultCacheSize > 0)
+    {
+      const std::string tablename = DatabaseDriverBase::resolveDatabaseTableName(
+          settings.stationtype, itsEngineParameters->stationtypeConfig);
+      const auto maxage = std::max(1, itsEngineParameters->valuesResultCacheMaxAge);
+      const auto now = Fmi::SecondClock::universal_time();
+      const auto seconds = (now - Fmi::date_time::from_time_t(0)).total_seconds();
+
+      resultKey = *queryKey + '|' +
+                  Fmi::to_string(itsEngineParameters->tableGenerations.get(tablename)) + '|' +
+                  Fmi::to_string(seconds / maxage);
+
+      auto cached = itsValuesResultCache.find(*resultKey);
+      if (cached)
+        return std::make_shared<TS::TimeSeriesVector>(**cached);
+    }
+
+    // A cancelled query must not fail the identical queries waiting for its result, hence
+    // only queries without a cancellation token are shared.
+    TS::TimeSeriesVectorPtr ret;
+    if (itsEngineParameters->coalesceIdenticalQueries && !settings.cancellation)
+      ret = itsInFlightQueries.run(*queryKey, query);
+    else
+      ret = query();
 
-    // Insert missing values for unknown parameters and
-    // arrange data order in result set
-    afterQuery(ret, settings, unknownParameterIndexes);
+    if (resultKey && ret)
+      itsValuesResultCache.insert(*resultKey, std::make_shared<TS::TimeSeriesVector>(*ret));
 
     return ret;
   }
@@ -579,13 +729,272 @@ TS::TimeSeriesVectorPtr EngineImpl::values(Settings &settings,
       std::cout << "EngineImpl::Observation::Settings:\n" << settings << '\n';
       std::cout << "TS::TimeSeriesGeneratorOptions:\n" << timeSeriesOptions << '\n';
     }
-    Settings querySettings = beforeQuery(settings, unknownParameterIndexes);
 
-    TS::TimeSeriesVectorPtr ret = itsDatabaseDriver->values(querySettings, timeSeriesOptions);
+    auto query = [&]()
+    {
+      checkCancellation(settings.cancellation);
+
+      Settings querySettings = beforeQuery(settings, unknownParameterIndexes);
+
+      TS::TimeSeriesVectorPtr ret = admittedValues(
+          querySettings,
+          &timeSeriesOptions,
+          [&]() { return itsDatabaseDriver->values(querySettings, timeSeriesOptions); });
+
+      // Insert missing values for unknown parameters and
+      // arrange data order in result set
+      afterQuery(ret, settings, unknownParameterIndexes);
+
+      return ret;
+    };
+
+    return sharedValues(settings, optionsKey(timeSeriesOptions), query);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run several queries in one call
+ *
+ * Queries which differ only by their FMISID lists are merged into a single query
+ * for the union of the stations, and the result is split back by station.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<TS::TimeSeriesVectorPtr> EngineImpl::values(std::vector<Settings> &settings)
+{
+  try
+  {
+    std::vector<TS::TimeSeriesVectorPtr> ret(settings.size());
+
+    // Queries with identical settings apart from the FMISIDs
+
+    std::map<std::string, std::vector<std::size_t>> batches;
+    std::vector<std::size_t> singles;
+
+    for (std::size_t i = 0; i < settings.size(); i++)
+    {
+      if (stationsGivenAsFmisids(settings[i]))
+      {
+        Settings key = settings[i];
+        key.taggedFMISIDs.clear();
+        batches[key.key()].push_back(i);
+      }
+      else
+        singles.push_back(i);
+    }
+
+    for (auto &item : batches)
+    {
+      if (item.second.size() == 1)
+        singles.push_back(item.second.front());
+      else
+        mergedValues(settings, item.second, ret, singles);
+    }
+
+    // Identical queries are run only once
+
+    std::map<std::string, std::size_t> done;
+    for (auto i : singles)
+    {
+      const auto key = valuesQueryKey(settings[i]);
+      if (key)
+      {
+        auto pos = done.find(*key);
+        if (pos != done.end())
+        {
+          const auto &result = ret[pos->second];
+          ret[i] = (result ? std::make_shared<TS::TimeSeriesVector>(*result) : result);
+          continue;
+        }
+        done.insert(std::make_pair(*key, i));
+      }
+      ret[i] = values(settings[i]);
+    }
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a query passing the result to the visitor one station at a time
+ *
+ * Stations given as FMISIDs are queried in chunks of visitStationChunkSize
+ * stations so that only one chunk is kept in memory at a time. Other queries
+ * are run as a whole and split by station afterwards, hence only the FMISID
+ * queries have a bounded memory use. The location limit applies to the whole
+ * query. The values are moved out of the result instead of being copied.
+ */
+// ----------------------------------------------------------------------
+
+void EngineImpl::visitValues(Settings &settings, const StationValuesVisitor &visitor)
+{
+  try
+  {
+    const std::size_t chunkSize =
+        std::max<std::size_t>(1, itsEngineParameters->visitStationChunkSize);
+
+    Settings chunk = settings;
+    bool fmisidAdded = false;
+    const auto fmisidIndex = addFmisidParameter(chunk.parameters, fmisidAdded);
+
+    const bool chunked =
+        (stationsGivenAsFmisids(settings) && settings.taggedFMISIDs.size() > chunkSize);
+    const std::size_t n = (chunked ? settings.taggedFMISIDs.size() : 1);
+
+    // Each chunk would pass the location limit by itself
+    if (chunked)
+      TS::check_request_limit(settings.requestLimits, n, TS::RequestLimitMember::LOCATIONS);
+
+    for (std::size_t first = 0; first < n; first += chunkSize)
+    {
+      if (chunked)
+      {
+        const auto begin = settings.taggedFMISIDs.begin();
+        chunk.taggedFMISIDs.assign(begin + first, begin + std::min(n, first + chunkSize));
+      }
+
+      auto result = values(chunk);
+      if (!result || result->size() <= fmisidIndex)
+        continue;
+
+      // The row ranges are resolved first since the fmisid column is moved too
+      for (const auto &range : stationRowRanges(result->at(fmisidIndex)))
+      {
+        TS::TimeSeriesVector station;
+        for (std::size_t col = 0; col < result->size(); col++)
+        {
+          if (fmisidAdded && col == fmisidIndex)
+            continue;
+          TS::TimeSeries &ts = result->at(col);
+          TS::TimeSeries values;
+          values.insert(values.end(),
+                        std::make_move_iterator(ts.begin() + range.begin),
+                        std::make_move_iterator(ts.begin() + range.end));
+          station.emplace_back(std::move(values));
+        }
+        visitor(station);
+      }
+
+      // Release the chunk before querying the next one
+      result.reset();
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the query selects its stations by FMISIDs only
+ */
+// ----------------------------------------------------------------------
+
+bool EngineImpl::stationsGivenAsFmisids(const Settings &settings) const
+{
+  return (!settings.taggedFMISIDs.empty() && settings.taggedLocations.empty() &&
+          settings.boundingBox.empty() && settings.wktArea.empty() &&
+          !itsEngineParameters->isExternalOrMobileProducer(settings.stationtype));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate the number of stations of a query before running it
+ *
+ * Area queries are resolved using the station metadata, point locations
+ * are assumed to use the requested number of nearest stations.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t EngineImpl::estimateStationCount(const Settings &settings) const
+{
+  try
+  {
+    auto info = itsEngineParameters->stationInfo.load();
+
+    if (!settings.boundingBox.empty())
+      return info
+          ->findStationsInsideBox(settings.boundingBox.at("minx"),
+                                  settings.boundingBox.at("miny"),
+                                  settings.boundingBox.at("maxx"),
+                                  settings.boundingBox.at("maxy"),
+                                  settings.stationgroups,
+                                  settings.starttime,
+                                  settings.endtime)
+          .size();
+
+    if (!settings.wktArea.empty())
+      return info
+          ->findStationsInsideArea(
+              settings.stationgroups, settings.starttime, settings.endtime, settings.wktArea)
+          .size();
+
+    std::size_t count = settings.taggedFMISIDs.size();
+    count += settings.taggedLocations.size() *
+             static_cast<std::size_t>(std::max(1, settings.numberofstations));
+
+    if (settings.allplaces || count == 0)
+      return info->findStationsInGroup(settings.stationgroups, settings.starttime, settings.endtime)
+          .size();
+
+    return count;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run a database query under admission control
+ *
+ * Queries estimated to be too heavy are rejected or queued. The result is on
+ * the timestep grid of the query unless all data is requested, hence only
+ * the latter are used for learning the sampling rate of the stationtype.
+ */
+// ----------------------------------------------------------------------
+
+TS::TimeSeriesVectorPtr EngineImpl::admittedValues(
+    const Settings &settings,
+    const TS::TimeSeriesGeneratorOptions *timeSeriesOptions,
+    const std::function<TS::TimeSeriesVectorPtr()> &query)
+{
+  try
+  {
+    if (!itsQueryAdmission || !itsQueryAdmission->enabled())
+      return query();
+
+    // Queries without generator options use the timestep of the settings
+    unsigned int timestep = static_cast<unsigned int>(std::max(0, settings.timestep));
+    bool allData = false;
+    if (timeSeriesOptions != nullptr)
+    {
+      allData = timeSeriesOptions->all();
+      timestep = 0;
+      if (!allData && timeSeriesOptions->timeStep && *timeSeriesOptions->timeStep > 0)
+        timestep = static_cast<unsigned int>(*timeSeriesOptions->timeStep);
+    }
+
+    const auto nstations = estimateStationCount(settings);
+    auto permit = itsQueryAdmission->admit(
+        settings, itsQueryAdmission->estimate(settings, nstations, timestep));
+
+    auto ret = query();
 
-    // Insert missing values for unknown parameters and
-    // arrange data order in result set
-    afterQuery(ret, settings, unknownParameterIndexes);
+    if (allData && ret && !ret->empty())
+      itsQueryAdmission->record(settings, nstations, ret->front().size());
 
     return ret;
   }
@@ -595,6 +1004,135 @@ TS::TimeSeriesVectorPtr EngineImpl::values(Settings &settings,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Run queries differing only by their FMISIDs as one query
+ *
+ * Queries whose station tags conflict with the earlier queries of the batch
+ * are moved to the list of queries to be run separately. The request limits
+ * apply to the merged query as a whole, hence the stations of a merged query
+ * are capped at the location limit and the remaining queries are merged
+ * separately. The time step and element limits are checked for each query
+ * after the merged result has been split, since the merged query may exceed
+ * them even when none of the queries would.
+ */
+// ----------------------------------------------------------------------
+
+void EngineImpl::mergedValues(std::vector<Settings> &settings,
+                              const std::vector<std::size_t> &batch,
+                              std::vector<TS::TimeSeriesVectorPtr> &results,
+                              std::vector<std::size_t> &singles)
+{
+  try
+  {
+    Settings merged = settings[batch.front()];
+    merged.taggedFMISIDs.clear();
+
+    const auto maxlocations = static_cast<std::size_t>(merged.requestLimits.maxlocations);
+
+    std::map<int, const Spine::TaggedFMISID *> stations;
+    std::vector<std::size_t> members;
+    std::vector<std::size_t> remaining;
+
+    for (auto i : batch)
+    {
+      bool conflict = false;
+      std::size_t newstations = 0;
+      for (const auto &id : settings[i].taggedFMISIDs)
+      {
+        auto pos = stations.find(id.fmisid);
+        if (pos == stations.end())
+          ++newstations;
+        else if (pos->second->tag != id.tag || pos->second->direction != id.direction ||
+                 pos->second->distance != id.distance)
+          conflict = true;
+      }
+
+      if (conflict)
+      {
+        singles.push_back(i);
+        continue;
+      }
+
+      if (maxlocations > 0 && !members.empty() && stations.size() + newstations > maxlocations)
+      {
+        remaining.push_back(i);
+        continue;
+      }
+
+      members.push_back(i);
+      for (const auto &id : settings[i].taggedFMISIDs)
+      {
+        if (stations.insert(std::make_pair(id.fmisid, &id)).second)
+          merged.taggedFMISIDs.push_back(id);
+      }
+    }
+
+    if (remaining.size() == 1)
+      singles.push_back(remaining.front());
+    else if (!remaining.empty())
+      mergedValues(settings, remaining, results, singles);
+
+    if (members.size() == 1)
+    {
+      singles.push_back(members.front());
+      return;
+    }
+
+    // The result is split by the fmisid column, which is added temporarily if necessary
+
+    bool fmisidAdded = false;
+    const auto fmisidIndex = addFmisidParameter(merged.parameters, fmisidAdded);
+
+    merged.requestLimits.maxtimes = 0;
+    merged.requestLimits.maxelements = 0;
+
+    TS::TimeSeriesVectorPtr result = values(merged);
+
+    // No data. Like separate queries, return an empty time series for each parameter.
+    if (!result || result->size() <= fmisidIndex)
+    {
+      for (auto i : members)
+        results[i] = std::make_shared<TS::TimeSeriesVector>(settings[i].parameters.size());
+      return;
+    }
+
+    // Row ranges of each station in the merged result
+
+    std::map<std::string, std::vector<StationRows>> stationRows;
+    for (auto &range : stationRowRanges(result->at(fmisidIndex)))
+      stationRows[range.fmisid].push_back(range);
+
+    for (auto i : members)
+    {
+      auto tsv = std::make_shared<TS::TimeSeriesVector>();
+      for (std::size_t col = 0; col < result->size(); col++)
+      {
+        if (fmisidAdded && col == fmisidIndex)
+          continue;
+
+        const TS::TimeSeries &ts = result->at(col);
+        TS::TimeSeries selected;
+        for (const auto &id : settings[i].taggedFMISIDs)
+        {
+          auto pos = stationRows.find(Fmi::to_string(id.fmisid));
+          if (pos == stationRows.end())
+            continue;
+          for (const auto &range : pos->second)
+            selected.insert(selected.end(), ts.begin() + range.begin, ts.begin() + range.end);
+        }
+        tsv->emplace_back(std::move(selected));
+      }
+      checkMergedLimits(*tsv, settings[i].requestLimits);
+      results[i] = tsv;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 MetaData EngineImpl::metaData(const std::string &producer, const Settings &settings) const
 {
   try
@@ -886,11 +1424,18 @@ ContentTable EngineImpl::getStationInfo(const StationOptions &options) const
 
     const auto fmisids = sinfo->fmisids();
 
+    // Stations with a matching name in some period, each row is still checked separately
+    std::set<int> named_fmisids;
+    if (check_name)
+      named_fmisids = sinfo->findFmisidsByName(options.name);
+
     for (const auto fmisid : fmisids)
     {
       // Check data against options
       if (check_fmisid && options.fmisid.count(fmisid) == 0)
         continue;
+      if (check_name && named_fmisids.count(fmisid) == 0)
+        continue;
 
       // Get all variants of the fmisid
       std::vector<int> dummy{fmisid};
@@ -1031,6 +1576,10 @@ Fmi::Cache::CacheStatistics EngineImpl::getCacheStats() const
   ret.insert(std::make_pair("Observation::query_result_cache",
                             itsEngineParameters->queryResultBaseCache.statistics()));
 
+  if (itsEngineParameters->valuesResultCacheSize > 0)
+    ret.insert(std::make_pair("Observation::values_result_cache",
+                              itsValuesResultCache.statistics()));
+
   // Get private caches from drivers (Oracle-driver has some)
   auto private_caches = itsDatabaseDriver->getCacheStats();
   ret.insert(private_caches.begin(), private_caches.end());
@@ -3,9 +3,13 @@
 #include "DatabaseDriverInterface.h"
 #include "Engine.h"
 #include "EngineParameters.h"
+#include "InFlightQueries.h"
 #include "ObservationCache.h"
+#include "QueryAdmission.h"
 #include "StationOptions.h"
 #include <spine/Table.h>
+#include <functional>
+#include <optional>
 
 namespace SmartMet
 {
@@ -23,6 +27,8 @@ class EngineImpl : public Engine
   TS::TimeSeriesVectorPtr values(Settings &settings) override;
   TS::TimeSeriesVectorPtr values(Settings &settings,
                                  const TS::TimeSeriesGeneratorOptions &timeSeriesOptions) override;
+  std::vector<TS::TimeSeriesVectorPtr> values(std::vector<Settings> &settings) override;
+  void visitValues(Settings &settings, const StationValuesVisitor &visitor) override;
 
   void makeQuery(QueryBase *qb) override;
 
@@ -143,6 +149,20 @@ class EngineImpl : public Engine
   Settings beforeQuery(const Settings &settings,
                        std::vector<unsigned int> &unknownParameterIndexes) const;
 
+  std::optional<std::string> valuesQueryKey(const Settings &settings) const;
+  bool stationsGivenAsFmisids(const Settings &settings) const;
+  std::size_t estimateStationCount(const Settings &settings) const;
+  TS::TimeSeriesVectorPtr admittedValues(const Settings &settings,
+                                         const TS::TimeSeriesGeneratorOptions *timeSeriesOptions,
+                                         const std::function<TS::TimeSeriesVectorPtr()> &query);
+  void mergedValues(std::vector<Settings> &settings,
+                    const std::vector<std::size_t> &batch,
+                    std::vector<TS::TimeSeriesVectorPtr> &results,
+                    std::vector<std::size_t> &singles);
+  TS::TimeSeriesVectorPtr sharedValues(const Settings &settings,
+                                       const std::string &optionsKey,
+                                       const std::function<TS::TimeSeriesVectorPtr()> &query);
+
   Fmi::Cache::CacheStatistics getCacheStats() const override;
 
   std::unique_ptr<Spine::Table> requestProducerInfo(const Spine::HTTP::Request &theRequest) const;
@@ -173,6 +193,15 @@ class EngineImpl : public Engine
   std::unique_ptr<DatabaseDriverInterface> itsDatabaseDriver;
 
   std::shared_ptr<Geonames::Engine> itsGeonames;
+
+  // Results of repeated values() queries
+  Fmi::Cache::Cache<std::string, TS::TimeSeriesVectorPtr> itsValuesResultCache;
+
+  // Identical values() queries currently being executed
+  InFlightQueries itsInFlightQueries;
+
+  // Rejects too large values() queries and limits concurrent heavy queries
+  std::unique_ptr<QueryAdmission> itsQueryAdmission;
 };
 
 }  // namespace Observation
@@ -83,6 +83,27 @@ EngineParameters::EngineParameters(Spine::ConfigBase& cfg)
     queryResultBaseCacheSize =
         cfg.get_optional_config_param<size_t>("cache.queryResultBaseCacheSize", 1000);
 
+    valuesResultCacheSize = cfg.get_optional_config_param<size_t>("cache.valuesResultCacheSize", 0);
+    valuesResultCacheMaxAge =
+        cfg.get_optional_config_param<int>("cache.valuesResultCacheMaxAge", 60);
+    coalesceIdenticalQueries =
+        cfg.get_optional_config_param<bool>("cache.coalesceIdenticalQueries", true);
+    visitStationChunkSize = cfg.get_optional_config_param<size_t>("visitStationChunkSize", 100);
+    timeseriesBuildThreads = cfg.get_optional_config_param<size_t>("timeseriesBuildThreads", 4);
+    timeseriesBuildMinStations =
+        cfg.get_optional_config_param<size_t>("timeseriesBuildMinStations", 50);
+    queryPlanCacheSize = cfg.get_optional_config_param<size_t>("cache.queryPlanCacheSize", 1000);
+
+    queryAdmission.maxValues = cfg.get_optional_config_param<size_t>("admission.maxValues", 0);
+    queryAdmission.heavyQueryValues =
+        cfg.get_optional_config_param<size_t>("admission.heavyQueryValues", 0);
+    queryAdmission.maxHeavyQueryWeight =
+        cfg.get_optional_config_param<size_t>("admission.maxHeavyQueryWeight", 0);
+    queryAdmission.queueTimeout =
+        cfg.get_optional_config_param<int>("admission.queueTimeout", 10000);
+    queryAdmission.samplesPerHour =
+        cfg.get_optional_config_param<double>("admission.samplesPerHour", 6.0);
+
     nearestStationsCacheSize =
         cfg.get_optional_config_param<size_t>("cache.nearestStationsCacheSize", 10000);
     geoIdCacheSize = cfg.get_optional_config_param<size_t>("cache.geoIdCacheSize", 10000);
@@ -99,6 +120,8 @@ EngineParameters::EngineParameters(Spine::ConfigBase& cfg)
     nearestStationExtraCandidates =
         cfg.get_optional_config_param<int>("nearestStationExtraCandidates", 3);
 
+    hybridCacheQueries = cfg.get_optional_config_param<bool>("cache.hybridCacheQueries", false);
+
     parameterMap = createParameterMapping(cfg);
     readStationTypeConfig(cfg);
     readDataQualityConfig(cfg);
@@ -7,8 +7,10 @@
 #include "ObservationCache.h"
 #include "ObservationCacheProxy.h"
 #include "ProducerGroups.h"
+#include "QueryAdmission.h"
 #include "StationInfo.h"
 #include "StationtypeConfig.h"
+#include "TableGenerations.h"
 #include <boost/smart_ptr/atomic_shared_ptr.hpp>
 #include <macgyver/Cache.h>
 
@@ -41,6 +43,28 @@ struct EngineParameters
   std::size_t queryResultBaseCacheSize = 100;
   std::size_t spatiaLitePoolSize = 0;
 
+  // Result cache of values() queries, disabled if the size is zero. Entries expire when
+  // new data is written into the cached table or when they become older than max age.
+  std::size_t valuesResultCacheSize = 0;
+  int valuesResultCacheMaxAge = 60;  // seconds
+
+  // Run identical concurrent values() queries only once
+  bool coalesceIdenticalQueries = true;
+
+  // Max number of stations queried at a time by Engine::visitValues
+  std::size_t visitStationChunkSize = 100;
+
+  // Max number of threads used for building the time series of different stations in
+  // parallel, and the minimum number of stations for which parallel processing is used
+  std::size_t timeseriesBuildThreads = 4;
+  std::size_t timeseriesBuildMinStations = 50;
+
+  // Max number of compiled query mappings cached by stationtype and parameter list
+  std::size_t queryPlanCacheSize = 1000;
+
+  // Limits of values() queries based on their estimated size
+  QueryAdmissionLimits queryAdmission;
+
   // Sizes (max number of entries) of the targeted lookup caches in
   // DatabaseStations, used to speed up repeated station resolution across
   // parallel time steps (nearest-station candidate lists and geoid lookups).
@@ -63,6 +87,10 @@ struct EngineParameters
   // N + this value candidates and returns at most N that have data. Default is 3.
   int nearestStationExtraCandidates = 3;
 
+  // If the requested interval starts before the cached interval, read only the uncached
+  // head of the interval from the database and the rest from the cache.
+  bool hybridCacheQueries = false;
+
   std::string cacheDB;
   std::string dbDriverFile;
   DatabaseDriverInfo databaseDriverInfo;
@@ -72,6 +100,7 @@ struct EngineParameters
   // the shared pointer.
   mutable Fmi::AtomicSharedPtr<StationInfo> stationInfo;
   Fmi::Cache::Cache<std::string, std::shared_ptr<QueryResultBase>> queryResultBaseCache;
+  TableGenerations tableGenerations;
 
   bool quiet;
 
@@ -0,0 +1,76 @@
+#include "InFlightQueries.h"
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+TS::TimeSeriesVectorPtr copy(const TS::TimeSeriesVectorPtr& result)
+{
+  if (!result)
+    return result;
+  return std::make_shared<TS::TimeSeriesVector>(*result);
+}
+}  // anonymous namespace
+
+TS::TimeSeriesVectorPtr InFlightQueries::run(
+    const std::string& key, const std::function<TS::TimeSeriesVectorPtr()>& query)
+{
+  std::promise<TS::TimeSeriesVectorPtr> promise;
+  std::shared_future<TS::TimeSeriesVectorPtr> running;
+
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    auto pos = itsQueries.find(key);
+    if (pos != itsQueries.end())
+    {
+      ++pos->second.waiting;
+      running = pos->second.result;
+    }
+    else
+      itsQueries[key].result = promise.get_future().share();
+  }
+
+  // Wait for the identical query already running. The callers may modify the result,
+  // hence everyone gets a separate copy. get() rethrows the exception of the query.
+  if (running.valid())
+    return copy(running.get());
+
+  // Run the query. The entry is removed before the result is published so that the
+  // number of waiting callers is final.
+
+  auto finish = [&]()
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    auto pos = itsQueries.find(key);
+    std::size_t waiting = pos->second.waiting;
+    itsQueries.erase(pos);
+    return waiting;
+  };
+
+  TS::TimeSeriesVectorPtr result;
+  try
+  {
+    result = query();
+  }
+  catch (...)
+  {
+    finish();
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+
+  const auto waiting = finish();
+  promise.set_value(result);
+
+  if (waiting == 0)
+    return result;
+  return copy(result);
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <timeseries/TimeSeriesInclude.h>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Coalesces identical concurrent queries into a single execution. The first caller with
+// a given key runs the query, callers arriving while it is running wait for it to finish
+// and receive a copy of the same result. Exceptions are propagated to all callers.
+
+class InFlightQueries
+{
+ public:
+  TS::TimeSeriesVectorPtr run(const std::string& key,
+                              const std::function<TS::TimeSeriesVectorPtr()>& query);
+
+ private:
+  struct Query
+  {
+    std::shared_future<TS::TimeSeriesVectorPtr> result;
+    std::size_t waiting = 0;
+  };
+
+  std::mutex itsMutex;
+  std::map<std::string, Query> itsQueries;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
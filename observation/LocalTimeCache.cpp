@@ -0,0 +1,74 @@
+#include "LocalTimeCache.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+bool is_utc(const std::string& name)
+{
+  std::string tz = name;
+  Fmi::ascii_toupper(tz);
+  return (tz == "UTC" || tz == "ETC/UTC");
+}
+
+}  // anonymous namespace
+
+Fmi::LocalDateTime LocalTimeCache::Zone::localTime(const Fmi::DateTime& utc)
+{
+  try
+  {
+    if (itsUtc)
+      return Fmi::LocalDateTime(utc, itsZone);
+
+    // Usually the next time in order
+    if (itsNext < itsTimes.size() && itsTimes[itsNext].first == utc)
+      return itsTimes[itsNext++].second;
+
+    auto pos = std::lower_bound(itsTimes.begin(),
+                                itsTimes.end(),
+                                utc,
+                                [](const std::pair<Fmi::DateTime, Fmi::LocalDateTime>& item,
+                                   const Fmi::DateTime& t) { return item.first < t; });
+
+    if (pos == itsTimes.end() || pos->first != utc)
+      pos = itsTimes.emplace(pos, utc, Fmi::LocalDateTime(utc, itsZone));
+
+    itsNext = static_cast<std::size_t>(pos - itsTimes.begin()) + 1;
+    return pos->second;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+LocalTimeCache::Zone& LocalTimeCache::zone(const std::string& name)
+{
+  try
+  {
+    auto pos = itsZones.find(name);
+    if (pos == itsZones.end())
+    {
+      if (is_utc(name))
+        pos = itsZones.emplace(name, Zone(Fmi::TimeZonePtr::utc, true)).first;
+      else
+        pos = itsZones.emplace(name, Zone(itsTimeZones.time_zone_from_string(name), false)).first;
+    }
+    return pos->second;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <macgyver/LocalDateTime.h>
+#include <macgyver/TimeZones.h>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Memoized UTC to local time conversions for building a single result. Wide requests
+// contain the same timesteps for many stations, hence each (time zone, UTC time) pair is
+// converted only once and each time zone is looked up by name only once. UTC times are
+// not converted at all. The class is not thread safe, parallel workers must use instances
+// of their own.
+
+class LocalTimeCache
+{
+ public:
+  class Zone
+  {
+   public:
+    Zone(Fmi::TimeZonePtr tz, bool utc) : itsZone(std::move(tz)), itsUtc(utc) {}
+
+    const Fmi::TimeZonePtr& tz() const { return itsZone; }
+    Fmi::LocalDateTime localTime(const Fmi::DateTime& utc);
+
+   private:
+    Fmi::TimeZonePtr itsZone;
+    bool itsUtc = false;
+
+    // Conversions sorted by UTC time. The times of each station are scanned in ascending
+    // order, hence the next lookup is usually at the position following the previous one
+    // and new times are usually appended to the end.
+    std::vector<std::pair<Fmi::DateTime, Fmi::LocalDateTime>> itsTimes;
+    std::size_t itsNext = 0;
+  };
+
+  explicit LocalTimeCache(const Fmi::TimeZones& timezones) : itsTimeZones(timezones) {}
+
+  // References remain valid for the lifetime of the cache
+  Zone& zone(const std::string& name);
+
+ private:
+  const Fmi::TimeZones& itsTimeZones;
+  std::map<std::string, Zone> itsZones;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
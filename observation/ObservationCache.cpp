@@ -75,6 +75,11 @@ std::set<int> ObservationCache::stationsWithObservations(
   return {fmisids.begin(), fmisids.end()};
 }
 
+Fmi::DateTime ObservationCache::cachedIntervalStart(const Settings& /*settings*/) const
+{
+  return Fmi::DateTime::NOT_A_DATE_TIME;
+}
+
 ObservationCache::~ObservationCache() = default;
 
 }  // namespace Observation
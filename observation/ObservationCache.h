@@ -146,6 +146,11 @@ class ObservationCache
       const Fmi::DateTime &endtime,
       const std::string &tablename) const;
 
+  // Return the start of the continuously cached time interval for the table the
+  // stationtype in the settings is stored in, or NOT_A_DATE_TIME if the stationtype is not
+  // cached. Used for splitting queries into database and cache parts.
+  virtual Fmi::DateTime cachedIntervalStart(const Settings &settings) const;
+
  protected:
   ObservationCache(const CacheInfoItem &ci);
 
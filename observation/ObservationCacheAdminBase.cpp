@@ -5,6 +5,8 @@
 #include <macgyver/ThreadName.h>
 #include <spine/Convenience.h>
 #include <spine/Reactor.h>
+#include <algorithm>
+#include <exception>
 
 namespace SmartMet
 {
@@ -14,6 +16,12 @@ namespace Observation
 {
 using namespace Utils;
 
+namespace
+{
+// Number of concurrent Geonames lookups of stations not found in the bulk searches
+const std::size_t geonames_lookup_batches = 8;
+}  // anonymous namespace
+
 ObservationCacheAdminBase::ObservationCacheAdminBase(const DatabaseDriverParameters& parameters,
                                                      Engine::Geonames::Engine* geonames,
                                                      std::atomic<bool>& conn_ok,
@@ -23,7 +31,10 @@ ObservationCacheAdminBase::ObservationCacheAdminBase(const DatabaseDriverParamet
       itsGeonames(geonames),
       itsConnectionsOK(conn_ok),
       itsTimer(timer),
-      itsBackgroundTasks(new Fmi::AsyncTaskGroup)
+      itsBackgroundTasks(new Fmi::AsyncTaskGroup),
+      itsGeonamesCache(std::make_unique<StationGeonamesCache>(
+          parameters.params->serializedStationsFile + ".geonames",
+          parameters.stationsGeonamesCacheMaxAge))
 {
   itsBackgroundTasks->on_task_error(
       [](const std::string& task_name)
@@ -351,6 +362,7 @@ void ObservationCacheAdminBase::updateFlashFakeCache(std::shared_ptr<Observation
 
     auto begin2 = std::chrono::high_resolution_clock::now();
     auto count = cache->fillFlashDataCache(cacheData);
+    tableUpdated(FLASH_DATA_TABLE, count);
     auto end2 = std::chrono::high_resolution_clock::now();
     std::cout << Spine::log_time_str() << driverName() << " database driver wrote " << count
               << " FLASH observations between " << starttime << "..." << endtime << " finished in "
@@ -448,6 +460,8 @@ void ObservationCacheAdminBase::emulateFlashCacheUpdate(
               << total_count << '\n';
   }
 
+  tableUpdated(FLASH_DATA_TABLE, total_count);
+
   auto function_endtime = std::chrono::high_resolution_clock::now();
   std::cout << Spine::log_time_str() << driverName() << " database driver wrote " << total_count
             << " emulated flash observations between " << starttime << "..." << endtime
@@ -505,6 +519,7 @@ void ObservationCacheAdminBase::updateFlashCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = flashCache->fillFlashDataCache(flashCacheData);
+      tableUpdated(FLASH_DATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -562,6 +577,7 @@ void ObservationCacheAdminBase::updateObservationFakeCache(
 
     auto begin2 = std::chrono::high_resolution_clock::now();
     auto count = cache->fillDataCache(cacheData);
+    tableUpdated(OBSERVATION_DATA_TABLE, count);
     auto end2 = std::chrono::high_resolution_clock::now();
     std::cout << Spine::log_time_str() << driverName() << " database driver wrote " << count
               << " FIN observations between " << starttime << "..." << endtime << " finished in "
@@ -650,6 +666,7 @@ void ObservationCacheAdminBase::updateObservationCache() const
       auto count_moving_locations =
           observationCache->fillMovingLocationsCache(cacheDataMovingLocations);
       auto count = observationCache->fillDataCache(cacheData);
+      tableUpdated(OBSERVATION_DATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -734,6 +751,7 @@ void ObservationCacheAdminBase::updateWeatherDataQCFakeCache(
 
     auto begin2 = std::chrono::high_resolution_clock::now();
     auto count = cache->fillWeatherDataQCCache(cacheData);
+    tableUpdated(WEATHER_DATA_QC_TABLE, count);
     auto end2 = std::chrono::high_resolution_clock::now();
     std::cout << Spine::log_time_str() << driverName() << " database driver wrote " << count
               << " EXT observations between " << starttime << "..." << endtime << " finished in "
@@ -810,6 +828,7 @@ void ObservationCacheAdminBase::updateWeatherDataQCCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = weatherDataQCCache->fillWeatherDataQCCache(cacheData);
+      tableUpdated(WEATHER_DATA_QC_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -915,6 +934,7 @@ void ObservationCacheAdminBase::updateNetAtmoCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = netatmoCache->fillNetAtmoCache(cacheData);
+      tableUpdated(EXT_OBSDATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -1023,6 +1043,7 @@ void ObservationCacheAdminBase::updateRoadCloudCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = roadcloudCache->fillRoadCloudCache(cacheData);
+      tableUpdated(EXT_OBSDATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -1130,6 +1151,7 @@ void ObservationCacheAdminBase::updateFmiIoTCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = fmiIoTCache->fillFmiIoTCache(cacheData);
+      tableUpdated(EXT_OBSDATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -1237,6 +1259,7 @@ void ObservationCacheAdminBase::updateTapsiQcCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = tapsiQcCache->fillTapsiQcCache(cacheData);
+      tableUpdated(EXT_OBSDATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -1330,6 +1353,7 @@ void ObservationCacheAdminBase::updateMagnetometerCache() const
     {
       auto begin = std::chrono::high_resolution_clock::now();
       auto count = magnetometerCache->fillMagnetometerCache(cacheData);
+      tableUpdated(MAGNETOMETER_DATA_TABLE, count);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (itsTimer)
@@ -1654,9 +1678,25 @@ void ObservationCacheAdminBase::updateStationsCacheLoop()
   }
 }
 
+// Invalidate results computed from the table if new data was written into it
+void ObservationCacheAdminBase::tableUpdated(const std::string& tablename, std::size_t count) const
+{
+  if (count > 0)
+    itsParameters.params->tableGenerations.increment(tablename);
+}
+
 void ObservationCacheAdminBase::addInfoToStations(Spine::Stations& stations,
                                                   const std::string& language) const
 {
+  // Stations whose information is not known from earlier reloads
+  std::vector<Spine::Station*> missing;
+  for (Spine::Station& station : stations)
+    if (!itsGeonamesCache->get(station, language))
+      missing.push_back(&station);
+
+  if (missing.empty())
+    return;
+
   Locus::QueryOptions opts;
   opts.SetLanguage(language);
   opts.SetResultLimit(50000);
@@ -1675,44 +1715,145 @@ void ObservationCacheAdminBase::addInfoToStations(Spine::Stations& stations,
 
   locationList.splice(locationList.end(), locationList2);
 
-  std::set<int> processed_stations;
-
   std::map<int, Spine::LocationPtr> locations;
 
   for (const auto& loc : locationList)
     if (loc->fmisid)
       locations[*loc->fmisid] = loc;
 
-  for (Spine::Station& station : stations)
+  std::vector<Spine::Station*> remaining;
+
+  for (Spine::Station* station : missing)
   {
     if (Spine::Reactor::isShuttingDown())
       return;
 
-    if (locations.find(station.fmisid) != locations.end())
+    if (locations.find(station->fmisid) != locations.end())
     {
-      const Spine::LocationPtr& place = locations.at(station.fmisid);
-      station.country = place->country;
-      station.iso2 = place->iso2;
-      station.geoid = place->geoid;
-      station.requestedLat = place->latitude;
-      station.requestedLon = place->longitude;
-      station.requestedName = place->name;
-      station.timezone = place->timezone;
-      station.region = place->area;
-      station.elevation = place->elevation;
-      processed_stations.insert(station.fmisid);
+      const Spine::LocationPtr& place = locations.at(station->fmisid);
+      station->country = place->country;
+      station->iso2 = place->iso2;
+      station->geoid = place->geoid;
+      station->requestedLat = place->latitude;
+      station->requestedLon = place->longitude;
+      station->requestedName = place->name;
+      station->timezone = place->timezone;
+      station->region = place->area;
+      station->elevation = place->elevation;
+      itsGeonamesCache->set(*station, language);
+    }
+    else
+      remaining.push_back(station);
+  }
+
+  // Update info of the remainig stations one at a time in parallel batches
+  const std::size_t nbatches = std::min(geonames_lookup_batches, remaining.size());
+  const std::size_t batchsize = (nbatches > 0 ? (remaining.size() + nbatches - 1) / nbatches : 0);
+
+  std::vector<char> found(remaining.size(), 0);
+  std::vector<std::exception_ptr> errors(nbatches);
+  Fmi::AsyncTaskGroup tasks;
+  for (std::size_t b = 0; b < nbatches; b++)
+  {
+    tasks.add("geonames-lookup",
+              [&, b]()
+              {
+                try
+                {
+                  const auto last = std::min(remaining.size(), (b + 1) * batchsize);
+                  for (std::size_t i = b * batchsize; i < last; i++)
+                  {
+                    if (Spine::Reactor::isShuttingDown())
+                      return;
+                    found[i] = addInfoToStation(*remaining[i], language);
+                  }
+                }
+                catch (...)
+                {
+                  errors[b] = std::current_exception();
+                }
+              });
+  }
+  tasks.wait();
+
+  if (Spine::Reactor::isShuttingDown())
+    throw Fmi::Exception(BCP, "[ObservationCacheAdminBase] Station updates aborted due to shutdown")
+        .disableLogging();
+
+  for (const auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+
+  for (std::size_t i = 0; i < remaining.size(); i++)
+    if (found[i])
+      itsGeonamesCache->set(*remaining[i], language);
+
+  itsGeonamesCache->save();
+}
+
+void ObservationCacheAdminBase::addInfoToStations(Spine::Stations& stations,
+                                                  const StationInfo& previous,
+                                                  const std::string& language) const
+{
+  try
+  {
+    std::map<int, const Spine::Station*> known;
+    for (const auto& station : previous.stations)
+      known.emplace(station.fmisid, &station);
+
+    Spine::Stations unknown;
+    std::vector<std::size_t> positions;
+
+    for (std::size_t i = 0; i < stations.size(); ++i)
+    {
+      auto& station = stations[i];
+      auto pos = known.find(station.fmisid);
+      if (pos != known.end() && pos->second->longitude == station.longitude &&
+          pos->second->latitude == station.latitude)
+      {
+        const auto& old = *pos->second;
+        station.country = old.country;
+        station.iso2 = old.iso2;
+        station.geoid = old.geoid;
+        station.requestedLat = old.requestedLat;
+        station.requestedLon = old.requestedLon;
+        station.requestedName = old.requestedName;
+        station.timezone = old.timezone;
+        station.region = old.region;
+        station.elevation = old.elevation;
+        station.stationDirection = old.stationDirection;
+      }
+      else
+      {
+        unknown.push_back(station);
+        positions.push_back(i);
+      }
     }
+
+    if (unknown.empty())
+      return;
+
+    addInfoToStations(unknown, language);
+
+    for (std::size_t i = 0; i < positions.size(); ++i)
+      stations[positions[i]] = unknown[i];
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
+}
 
-  // Update info of the remainig stations
-  for (Spine::Station& station : stations)
+void ObservationCacheAdminBase::removeObsoleteGeonamesInfo(const Spine::Stations& stations) const
+{
+  try
   {
-    if (Spine::Reactor::isShuttingDown())
-      throw Fmi::Exception(BCP,
-                           "[ObservationCacheAdminBase] Station updates aborted due to shutdown")
-          .disableLogging();
-    if (processed_stations.find(station.fmisid) == processed_stations.end())
-      addInfoToStation(station, language);
+    itsGeonamesCache->retain(stations);
+    itsGeonamesCache->save();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
 
@@ -1786,7 +1927,7 @@ void ObservationCacheAdminBase::calculateStationDirection(Spine::Station& statio
   }
 }
 
-void ObservationCacheAdminBase::addInfoToStation(Spine::Station& station,
+bool ObservationCacheAdminBase::addInfoToStation(Spine::Station& station,
                                                  const std::string& language) const
 {
   try
@@ -1849,7 +1990,7 @@ void ObservationCacheAdminBase::addInfoToStation(Spine::Station& station,
     }
     catch (...)
     {
-      return;
+      return false;
     }
 
     for (const auto& place : places)
@@ -1866,6 +2007,7 @@ void ObservationCacheAdminBase::addInfoToStation(Spine::Station& station,
     }
 
     calculateStationDirection(station);
+    return !places.empty();
   }
   catch (...)
   {
@@ -2,6 +2,7 @@
 
 #include "DatabaseDriverParameters.h"
 #include "ObservationCacheProxy.h"
+#include "StationGeonamesCache.h"
 #include <engines/geonames/Engine.h>
 #include <macgyver/AsyncTaskGroup.h>
 #include <macgyver/TimeZones.h>
@@ -86,6 +87,12 @@ class ObservationCacheAdminBase
                             bool timer);
 
   void addInfoToStations(Spine::Stations& stations, const std::string& language) const;
+  // Reuses the Geonames information of stations whose location has not changed
+  void addInfoToStations(Spine::Stations& stations,
+                         const StationInfo& previous,
+                         const std::string& language) const;
+  // Forget the saved Geonames information of stations which no longer exist
+  void removeObsoleteGeonamesInfo(const Spine::Stations& stations) const;
 
   const DatabaseDriverParameters& itsParameters;
   const std::shared_ptr<ObservationCacheProxy> itsCacheProxy;
@@ -100,6 +107,7 @@ class ObservationCacheAdminBase
   void updateWeatherDataQCFakeCache(std::shared_ptr<ObservationCache>& cache) const;
   void updateFlashFakeCache(std::shared_ptr<ObservationCache>& cache) const;
   void emulateFlashCacheUpdate(std::shared_ptr<ObservationCache>& cache) const;
+  void tableUpdated(const std::string& tablename, std::size_t count) const;
 
   void startCacheUpdateThreads(const std::set<std::string>& tables);
   void startInitialCacheUpdates(std::shared_ptr<ObservationCache> observationCache,
@@ -134,11 +142,14 @@ class ObservationCacheAdminBase
   void fixWeatherDataQCProducers(DataItems& data) const;
 
   void calculateStationDirection(Spine::Station& station) const;
-  void addInfoToStation(Spine::Station& station, const std::string& language) const;
+  bool addInfoToStation(Spine::Station& station, const std::string& language) const;
   std::shared_ptr<ObservationCache> getCache(const std::string& tablename) const;
   std::string driverName() const;
 
   std::shared_ptr<Fmi::AsyncTaskGroup> itsBackgroundTasks;
+
+  // Geonames information of the stations saved next to the serialized stations
+  std::unique_ptr<StationGeonamesCache> itsGeonamesCache;
 };
 
 }  // namespace Observation
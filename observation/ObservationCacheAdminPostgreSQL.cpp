@@ -1,7 +1,9 @@
 #include "ObservationCacheAdminPostgreSQL.h"
 #include "PostgreSQLObsDB.h"
 #include "Utils.h"
+#include <macgyver/StringConversion.h>
 #include <spine/Reactor.h>
+#include <algorithm>
 
 namespace SmartMet
 {
@@ -11,6 +13,38 @@ namespace Observation
 {
 using namespace Utils;
 
+namespace
+{
+void setStationType(Spine::Station& station)
+{
+  if (station.type == "AWS" || station.type == "SYNOP" || station.type == "CLIM" ||
+      station.type == "AVI")
+  {
+    station.isFmi = true;
+  }
+  else if (station.type == "MAREO")
+  {
+    station.isMareograph = true;
+  }
+  else if (station.type == "BUOY")
+  {
+    station.isBuoy = true;
+  }
+  else if (station.type == "RWS" || station.type == "EXTRWS" || station.type == "EXTRWYWS")
+  {
+    station.isRoad = true;
+  }
+  else if (station.type == "EXTWATER")
+  {
+    station.isSyke = true;
+  }
+  else if (station.type == "EXTSYNOP")
+  {
+    station.isForeign = true;
+  }
+}
+}  // namespace
+
 ObservationCacheAdminPostgreSQL::ObservationCacheAdminPostgreSQL(
     const PostgreSQLDriverParameters& p,
     const std::unique_ptr<PostgreSQLObsDBConnectionPool>& pcp,
@@ -28,7 +62,8 @@ void ObservationCacheAdminPostgreSQL::readObservationCacheData(
     const std::string& measurandId,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readCacheDataFromPostgreSQL(cacheData, dataPeriod, fmisid, measurandId, itsTimeZones);
 }
 
@@ -37,7 +72,8 @@ void ObservationCacheAdminPostgreSQL::readFlashCacheData(
     const Fmi::TimePeriod& dataPeriod,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readFlashCacheDataFromPostgreSQL(cacheData, dataPeriod, itsTimeZones);
 }
 
@@ -48,7 +84,8 @@ void ObservationCacheAdminPostgreSQL::readWeatherDataQCCacheData(
     const std::string& measurandId,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readWeatherDataQCCacheDataFromPostgreSQL(
       cacheData, dataPeriod, fmisid, measurandId, itsTimeZones);
 }
@@ -59,7 +96,8 @@ void ObservationCacheAdminPostgreSQL::readMovingStationsCacheData(
     const Fmi::DateTime& lastModifiedTime,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readMovingStationsCacheDataFromPostgreSQL(
       cacheData, startTime, lastModifiedTime, itsTimeZones);
 }
@@ -70,7 +108,8 @@ void ObservationCacheAdminPostgreSQL::readObservationCacheData(
     const Fmi::DateTime& lastModifiedTime,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readCacheDataFromPostgreSQL(cacheData, startTime, lastModifiedTime, itsTimeZones);
 }
 
@@ -80,7 +119,8 @@ void ObservationCacheAdminPostgreSQL::readMagnetometerCacheData(
     const Fmi::DateTime& lastModifiedTime,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readMagnetometerCacheDataFromPostgreSQL(cacheData, startTime, lastModifiedTime, itsTimeZones);
 }
 
@@ -91,7 +131,8 @@ void ObservationCacheAdminPostgreSQL::readFlashCacheData(
     const Fmi::DateTime& lastModifiedTime,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readFlashCacheDataFromPostgreSQL(
       cacheData, startTime, lastStrokeTime, lastModifiedTime, itsTimeZones);
 }
@@ -102,7 +143,8 @@ void ObservationCacheAdminPostgreSQL::readWeatherDataQCCacheData(
     const Fmi::DateTime& lastModifiedTime,
     const Fmi::TimeZones& /* timezones */) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readWeatherDataQCCacheDataFromPostgreSQL(
       cacheData, startTime, lastModifiedTime, itsTimeZones);
 }
@@ -114,7 +156,8 @@ void ObservationCacheAdminPostgreSQL::readMobileCacheData(
     const Fmi::DateTime& lastCreatedTime,
     const Fmi::TimeZones& timeZones) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::CacheUpdate);
   db->readMobileCacheDataFromPostgreSQL(producer, cacheData, lastTime, lastCreatedTime, timeZones);
   if ((producer == FMI_IOT_PRODUCER) || (producer == TAPSI_QC_PRODUCER))
   {
@@ -152,7 +195,8 @@ void ObservationCacheAdminPostgreSQL::loadStations(const std::string& serialized
     if (Spine::Reactor::isShuttingDown())
       return;
 
-    std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+    std::shared_ptr<PostgreSQLObsDB> db =
+        itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::Admin);
     const std::string place = "Helsinki";
     const std::string lang = "fi";
     Spine::LocationPtr loc = itsGeonames->nameSearch(place, lang);
@@ -160,6 +204,20 @@ void ObservationCacheAdminPostgreSQL::loadStations(const std::string& serialized
     // Perhaps the point of above is to make sure the engine is available?
     // Moved the log message downwards accordingly.
 
+    // Only modified stations are read unless a full reload is due. Stations which are removed
+    // or change groups without being modified themselves are noticed in the full reloads.
+
+    auto previous = itsParameters.params->stationInfo.load();
+    const auto now = Fmi::SecondClock::universal_time();
+    const auto interval = itsParameters.stationsFullReloadInterval;
+
+    if (previous && !itsStationsModifiedLast.is_not_a_date_time() && interval > 0 &&
+        now < itsLastFullStationsReload + Fmi::Seconds(interval))
+    {
+      loadModifiedStations(*db, *previous, serializedStationsFile);
+      return;
+    }
+
     logMessage(
         "[PostgreSQLDatabaseDriver] Loading stations from " + itsParameters.driverName + "...",
         itsParameters.quiet);
@@ -174,38 +232,15 @@ void ObservationCacheAdminPostgreSQL::loadStations(const std::string& serialized
       if (Spine::Reactor::isShuttingDown())
         return;
 
-      if (station.type == "AWS" || station.type == "SYNOP" || station.type == "CLIM" ||
-          station.type == "AVI")
-      {
-        station.isFmi = true;
-      }
-      else if (station.type == "MAREO")
-      {
-        station.isMareograph = true;
-      }
-      else if (station.type == "BUOY")
-      {
-        station.isBuoy = true;
-      }
-      else if (station.type == "RWS" || station.type == "EXTRWS" || station.type == "EXTRWYWS")
-      {
-        station.isRoad = true;
-      }
-      else if (station.type == "EXTWATER")
-      {
-        station.isSyke = true;
-      }
-      else if (station.type == "EXTSYNOP")
-      {
-        station.isForeign = true;
-      }
-
-      if (Spine::Reactor::isShuttingDown())
-        throw Fmi::Exception(
-            BCP, "PostgreSQLDatabaseDriver: Aborting station preload due to shutdown request");
+      setStationType(station);
     }
 
-    addInfoToStations(newStationInfo->stations, "");
+    if (previous)
+      addInfoToStations(newStationInfo->stations, *previous, "");
+    else
+      addInfoToStations(newStationInfo->stations, "");
+
+    removeObsoleteGeonamesInfo(newStationInfo->stations);
 
     // Serialize stations to disk and swap the contents into itsParameters.params->stationInfo
 
@@ -214,6 +249,13 @@ void ObservationCacheAdminPostgreSQL::loadStations(const std::string& serialized
 
     itsParameters.params->stationInfo.store(newStationInfo);
 
+    itsLastFullStationsReload = now;
+    itsStationsModifiedLast = Fmi::DateTime();
+    for (const auto& station : newStationInfo->stations)
+      if (itsStationsModifiedLast.is_not_a_date_time() ||
+          station.modified_last > itsStationsModifiedLast)
+        itsStationsModifiedLast = station.modified_last;
+
     logMessage("[PostgreSQLDatabaseDriver] Loading stations done.", itsParameters.quiet);
   }
   catch (...)
@@ -223,6 +265,91 @@ void ObservationCacheAdminPostgreSQL::loadStations(const std::string& serialized
   }
 }
 
+void ObservationCacheAdminPostgreSQL::loadModifiedStations(
+    PostgreSQLObsDB& db,
+    const StationInfo& previous,
+    const std::string& serializedStationsFile)
+{
+  try
+  {
+    // Read a little extra for safety like in the cache updates
+    const auto since = itsStationsModifiedLast - Fmi::Seconds(itsParameters.updateExtraInterval);
+
+    std::map<int, Fmi::DateTime> modified;
+    Spine::Stations rows;
+    db.getStations(rows, since, modified);
+
+    // Stations within the safety margin may already have been handled. A late commit may
+    // carry an older modification time than the latest station seen so far, hence each
+    // station is compared with its own modification time in the current metadata. Private
+    // stations are reported as modified but have no rows, they matter only if they used to be
+    // public and must now be removed.
+
+    std::set<int> rowFmisids;
+    for (const auto& station : rows)
+      rowFmisids.insert(station.fmisid);
+
+    std::set<int> fmisids;
+    auto modifiedLast = itsStationsModifiedLast;
+    for (const auto& fmisid_time : modified)
+    {
+      const auto previousStations =
+          previous.findFmisidStations(std::vector<int>{fmisid_time.first});
+      if (previousStations.empty() && rowFmisids.count(fmisid_time.first) == 0)
+        continue;
+
+      Fmi::DateTime previousModified;
+      for (const auto& station : previousStations)
+        if (previousModified.is_not_a_date_time() || station.modified_last > previousModified)
+          previousModified = station.modified_last;
+
+      if (fmisid_time.second == previousModified)
+        continue;
+
+      fmisids.insert(fmisid_time.first);
+      if (fmisid_time.second > modifiedLast)
+        modifiedLast = fmisid_time.second;
+    }
+
+    if (fmisids.empty())
+      return;
+
+    rows.erase(std::remove_if(rows.begin(),
+                              rows.end(),
+                              [&fmisids](const Spine::Station& station)
+                              { return fmisids.count(station.fmisid) == 0; }),
+               rows.end());
+
+    logMessage("[PostgreSQLDatabaseDriver] Updating " + Fmi::to_string(fmisids.size()) +
+                   " modified stations from " + itsParameters.driverName + "...",
+               itsParameters.quiet);
+
+    for (Spine::Station& station : rows)
+    {
+      if (Spine::Reactor::isShuttingDown())
+        return;
+
+      setStationType(station);
+    }
+
+    addInfoToStations(rows, previous, "");
+
+    auto newStationInfo = previous.patch(fmisids, rows);
+
+    logMessage("[PostgreSQLDatabaseDriver] Serializing stations...", itsParameters.quiet);
+    newStationInfo->serialize(serializedStationsFile);
+
+    itsParameters.params->stationInfo.store(newStationInfo);
+    itsStationsModifiedLast = modifiedLast;
+
+    logMessage("[PostgreSQLDatabaseDriver] Updating stations done.", itsParameters.quiet);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 std::pair<Fmi::DateTime, Fmi::DateTime> ObservationCacheAdminPostgreSQL::getLatestWeatherDataQCTime(
     const std::shared_ptr<ObservationCache>& cache) const
 {
@@ -69,7 +69,13 @@ class ObservationCacheAdminPostgreSQL : public ObservationCacheAdminBase
   void loadStations(const std::string& serializedStationsFile) override;
 
  private:
+  void loadModifiedStations(PostgreSQLObsDB& db,
+                            const StationInfo& previous,
+                            const std::string& serializedStationsFile);
+
   const std::unique_ptr<PostgreSQLObsDBConnectionPool>& itsPostgreSQLConnectionPool;
+  Fmi::DateTime itsLastFullStationsReload;  // time of the last full station reload
+  Fmi::DateTime itsStationsModifiedLast;    // latest modification time of the stations
 };
 
 }  // namespace Observation
@@ -1,9 +1,12 @@
 #include "ObservationMemoryCache.h"
+#include "Aggregation.h"
 #include "QueryMapping.h"
 #include "StationInfo.h"
 #include <boost/atomic.hpp>
 #include <boost/make_shared.hpp>
 #include <macgyver/Exception.h>
+#include <algorithm>
+#include <iterator>
 
 namespace SmartMet
 {
@@ -53,6 +56,52 @@ bool shouldIncludeObservation(const DataItem &obs,
   return true;
 }
 
+// Latest observation queries (wantedtime at or after the end time) need only the observations
+// of the latest time in the interval of each station. The station data is sorted by time,
+// hence they are found by scanning backwards from the end time instead of reading the whole
+// interval.
+bool isLatestObservationQuery(const Settings &settings)
+{
+  return (settings.wantedtime && *settings.wantedtime >= settings.endtime &&
+          *settings.wantedtime > settings.starttime);
+}
+
+void addLatestObservations(const DataItems &obsdata,
+                           const Spine::Station &station,
+                           const Settings &settings,
+                           const QueryMapping &qmap,
+                           const std::set<int> &valid_sensors,
+                           LocationDataItems &ret)
+{
+  auto cmp = [](const Fmi::DateTime &t, const DataItem &obs) -> bool
+  { return (t < obs.data_time); };
+
+  const auto end = std::upper_bound(obsdata.begin(), obsdata.end(), settings.endtime, cmp);
+
+  auto pos = end;
+  while (pos != obsdata.begin())
+  {
+    --pos;
+    if (pos->data_time < settings.starttime)
+      return;
+
+    if (shouldIncludeObservation(*pos, settings, qmap, valid_sensors))
+    {
+      // Extract all wanted parameters of the latest time in the original order
+      const auto latest = pos->data_time;
+      while (pos != obsdata.begin() && std::prev(pos)->data_time == latest)
+        --pos;
+      for (; pos != end; ++pos)
+      {
+        if (shouldIncludeObservation(*pos, settings, qmap, valid_sensors))
+          ret.emplace_back(LocationDataItem{
+              *pos, station.longitude, station.latitude, station.elevation, station.type});
+      }
+      return;
+    }
+  }
+}
+
 }  // anonymous namespace
 
 ObservationMemoryCache::~ObservationMemoryCache()
@@ -320,10 +369,17 @@ LocationDataItems ObservationMemoryCache::read_observations(
     for (const auto& item : qmap.sensorNumberToMeasurandIds)
       valid_sensors.insert(item.first);
 
+    // Aggregated queries need the whole interval to find the last complete bucket
+    const bool latest_only = isLatestObservationQuery(settings) && !settings.aggregation;
+
+    const auto groupmask = stationInfo.groupMask(stationgroup_codes);
+
     for (const auto& station : stations)
     {
+      checkCancellation(settings.cancellation);
+
       // Accept station only if group condition is satisfied
-      if (!stationInfo.belongsToGroup(station.fmisid, stationgroup_codes))
+      if (!stationInfo.belongsToGroup(station.fmisid, groupmask))
         continue;
 
       // Find station specific data
@@ -334,6 +390,12 @@ LocationDataItems ObservationMemoryCache::read_observations(
       // Safe shared copy of the station observations right at this moment
       auto obsdata = pos->second->load();
 
+      if (latest_only)
+      {
+        addLatestObservations(*obsdata, station, settings, qmap, valid_sensors, ret);
+        continue;
+      }
+
       // Find first position >= than the given start time
 
       auto cmp = [](const DataItem& obs, const Fmi::DateTime& t) -> bool
@@ -373,6 +435,10 @@ LocationDataItems ObservationMemoryCache::read_observations(
       }
     }
 
+    if (settings.aggregation)
+      return aggregateObservations(
+          ret, *settings.aggregation, settings.starttime, settings.endtime);
+
     return ret;
   }
   catch (...)
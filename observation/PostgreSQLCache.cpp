@@ -466,6 +466,36 @@ bool PostgreSQLCache::dataAvailableInCache(const Settings &settings) const
   }
 }
 
+Fmi::DateTime PostgreSQLCache::cachedIntervalStart(const Settings &settings) const
+{
+  try
+  {
+    if (settings.stationtype == "opendata" || settings.stationtype == "fmi" ||
+        settings.stationtype == "opendata_mareograph" || settings.stationtype == "opendata_buoy" ||
+        settings.stationtype == "research" || settings.stationtype == "syke")
+    {
+      Spine::ReadLock lock(itsTimeIntervalMutex);
+      if (itsTimeIntervalEnd.is_not_a_date_time())
+        return Fmi::DateTime::NOT_A_DATE_TIME;
+      return itsTimeIntervalStart;
+    }
+
+    if (settings.stationtype == "road" || settings.stationtype == "foreign")
+    {
+      Spine::ReadLock lock(itsWeatherDataQCTimeIntervalMutex);
+      if (itsWeatherDataQCTimeIntervalEnd.is_not_a_date_time())
+        return Fmi::DateTime::NOT_A_DATE_TIME;
+      return itsWeatherDataQCTimeIntervalStart;
+    }
+
+    return Fmi::DateTime::NOT_A_DATE_TIME;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 FlashCounts PostgreSQLCache::getFlashCount(const Fmi::DateTime &starttime,
                                            const Fmi::DateTime &endtime,
                                            const Spine::TaggedLocationList &locations) const
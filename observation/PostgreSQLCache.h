@@ -45,6 +45,7 @@ class PostgreSQLCache : public ObservationCache
       Settings &settings, const TS::TimeSeriesGeneratorOptions &timeSeriesOptions) override;
 
   bool dataAvailableInCache(const Settings &settings) const override;
+  Fmi::DateTime cachedIntervalStart(const Settings &settings) const override;
   bool flashIntervalIsCached(const Fmi::DateTime &starttime,
                              const Fmi::DateTime &endtime) const override;
   FlashCounts getFlashCount(const Fmi::DateTime &starttime,
@@ -2225,16 +2225,22 @@ void PostgreSQLCacheDB::fetchWeatherDataQCData(const std::string &sqlStmt,
                                                const StationInfo &stationInfo,
                                                const std::set<std::string> &stationgroup_codes,
                                                const TS::RequestLimits &requestLimits,
+                                               const QueryCancellationPtr &cancellation,
                                                LocationDataItems &cacheData)
 {
   try
   {
-    pqxx::result result_set = itsDB.executeNonTransaction(sqlStmt);
+    pqxx::result result_set = executeCancellable(sqlStmt, cancellation);
 
     std::set<int> fmisids;
     std::set<Fmi::DateTime> obstimes;
+    std::size_t nrows = 0;
     for (auto row : result_set)
     {
+      // Converting a large result may take a while too
+      if ((++nrows & 0xfff) == 0)
+        checkCancellation(cancellation);
+
       std::optional<int> fmisid = as_int(row[0]);
       Fmi::DateTime obstime = Fmi::date_time::from_time_t(row[1].as<time_t>());
       std::optional<int> parameter = as_int(row[2]);
@@ -368,6 +368,7 @@ class PostgreSQLCacheDB : public CommonPostgreSQLFunctions
                               const StationInfo &stationInfo,
                               const std::set<std::string> &stationgroup_codes,
                               const TS::RequestLimits &requestLimits,
+                              const QueryCancellationPtr &cancellation,
                               LocationDataItems &cacheData) override;
   std::string sqlSelectFromWeatherDataQCData(const Settings &settings,
                                              const std::string &params,
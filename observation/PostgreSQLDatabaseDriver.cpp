@@ -70,6 +70,19 @@ void PostgreSQLDatabaseDriver::readConfig(Spine::ConfigBase &cfg)
     itsParameters.connectionOptions.push_back(connectionOptions);
     itsParameters.connectionPoolSize.push_back(Fmi::stoi(driverInfo.params.at("poolSize")));
 
+    for (auto priority : {ConnectionPriority::Interactive,
+                          ConnectionPriority::CacheUpdate,
+                          ConnectionPriority::Admin})
+    {
+      const auto& name = priorityName(priority);
+      auto& limits = itsParameters.connectionPriorityLimits[priorityIndex(priority)];
+      const auto reserved = driverInfo.getIntParameterValue("priority_" + name + "_reserved", 0);
+      const auto percentage =
+          driverInfo.getIntParameterValue("priority_" + name + "_max_percentage", 100);
+      limits.reserved = static_cast<std::size_t>(std::max(0, reserved));
+      limits.maxPercentage = static_cast<std::size_t>(std::max(0, percentage));
+    }
+
     DatabaseDriverBase::readConfig(cfg, itsParameters);
   }
   catch (...)
@@ -5,6 +5,7 @@
 #include "QueryResult.h"
 #include "StationInfo.h"
 #include "StationtypeConfig.h"
+#include "Utils.h"
 #include <boost/make_shared.hpp>
 #include <macgyver/DateTime.h>
 #include <spine/Convenience.h>
@@ -24,6 +25,10 @@ namespace Observation
 {
 namespace
 {
+// Data newer than this from the start of the cached interval is read from the cache in
+// hybrid queries. The margin protects against the cache being cleaned during the query.
+const Fmi::TimeDuration hybridQuerySafetyMargin = Fmi::Hours(1);
+
 void setSettings(Settings &settings, PostgreSQLObsDB &db)
 {
   try
@@ -192,6 +197,8 @@ TS::TimeSeriesVectorPtr PostgreSQLDatabaseDriverForFmiData::values(Settings &set
       settings.dataFilter.setDataFilter("data_quality", it->second);
   }
 
+  std::shared_ptr<ObservationCache> hybridCache;
+
   // Try first from cache and on failure (Fmi::Exception::) get from
   // database.
   try
@@ -210,6 +217,9 @@ TS::TimeSeriesVectorPtr PostgreSQLDatabaseDriverForFmiData::values(Settings &set
       {
         return cache->valuesFromCache(settings);
       }
+
+      if (cache && itsParameters.params->hybridCacheQueries)
+        hybridCache = cache;
     }
   }
   catch (...)
@@ -217,8 +227,19 @@ TS::TimeSeriesVectorPtr PostgreSQLDatabaseDriverForFmiData::values(Settings &set
     throw Fmi::Exception::Trace(BCP, "Reading data from cache failed!");
   }
 
-  /*  FROM THIS POINT ONWARDS DATA IS REQUESTED FROM ORIGINAL DATABASE */
+  // Read the uncached head of the interval from the database and the rest from the cache
+  if (hybridCache)
+  {
+    auto ret = hybridValues(settings, *hybridCache);
+    if (ret)
+      return ret;
+  }
+
+  return valuesFromDatabase(settings);
+}
 
+TS::TimeSeriesVectorPtr PostgreSQLDatabaseDriverForFmiData::valuesFromDatabase(Settings &settings)
+{
   try
   {
     TS::TimeSeriesVectorPtr ret = std::make_shared<TS::TimeSeriesVector>();
@@ -289,6 +310,68 @@ TS::TimeSeriesVectorPtr PostgreSQLDatabaseDriverForFmiData::values(Settings &set
   }
 }
 
+/*
+ * \brief Read the head of the interval from the database and the tail from the cache.
+ *
+ * Returns nullptr if the query cannot be split, in which case everything is read from the
+ * database.
+ */
+
+TS::TimeSeriesVectorPtr PostgreSQLDatabaseDriverForFmiData::hybridValues(Settings &settings,
+                                                                         ObservationCache &cache)
+{
+  try
+  {
+    if (settings.wantedtime || settings.preventDatabaseQuery || !itsConnectionsOK ||
+        settings.starttime.is_not_a_date_time() || settings.endtime.is_not_a_date_time())
+      return nullptr;
+
+    if (settings.stationtype == ICEBUOY_PRODUCER || settings.stationtype == COPERNICUS_PRODUCER)
+      return nullptr;
+
+    std::string tablename = DatabaseDriverBase::resolveDatabaseTableName(
+        settings.stationtype, itsParameters.params->stationtypeConfig);
+    if (tablename != OBSERVATION_DATA_TABLE && tablename != WEATHER_DATA_QC_TABLE)
+      return nullptr;
+
+    Fmi::DateTime splitTime = Utils::hybridQuerySplitTime(
+        settings, cache.cachedIntervalStart(settings), hybridQuerySafetyMargin);
+    if (splitTime.is_not_a_date_time())
+      return nullptr;
+
+    // The stations of the two parts are matched using fmisid
+    Settings dbSettings = settings;
+    bool fmisidAdded = false;
+    const auto fmisidIndex = Utils::addFmisidParameter(dbSettings.parameters, fmisidAdded);
+    dbSettings.endtime = splitTime - Fmi::Seconds(1);
+
+    Settings cacheSettings = dbSettings;
+    cacheSettings.starttime = splitTime;
+    cacheSettings.endtime = settings.endtime;
+
+    if (settings.debug_options & Settings::DUMP_SETTINGS)
+      std::cout << "Hybrid query for stationtype " << settings.stationtype << ": database "
+                << Fmi::to_iso_string(settings.starttime) << " - "
+                << Fmi::to_iso_string(dbSettings.endtime) << ", cache "
+                << Fmi::to_iso_string(splitTime) << " - " << Fmi::to_iso_string(settings.endtime)
+                << '\n';
+
+    auto head = valuesFromDatabase(dbSettings);
+    auto tail = cache.valuesFromCache(cacheSettings);
+
+    auto ret = Utils::mergeStationTimeSeries(head, tail, fmisidIndex);
+
+    if (fmisidAdded && ret && ret->size() > fmisidIndex)
+      ret->erase(ret->begin() + fmisidIndex);
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Reading data from database and cache failed!");
+  }
+}
+
 /*
  * \brief Read values for given times only.
  */
@@ -500,19 +583,22 @@ void PostgreSQLDatabaseDriverForFmiData::readConfig(Spine::ConfigBase &cfg)
 
 void PostgreSQLDatabaseDriverForFmiData::getStationGroups(StationGroups &sg) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::Admin);
   db->getStationGroups(sg);
 }
 
 void PostgreSQLDatabaseDriverForFmiData::getProducerGroups(ProducerGroups &pg) const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::Admin);
   db->getProducerGroups(pg);
 }
 
 MeasurandInfo PostgreSQLDatabaseDriverForFmiData::getMeasurandInfo() const
 {
-  std::shared_ptr<PostgreSQLObsDB> db = itsPostgreSQLConnectionPool->getConnection(false);
+  std::shared_ptr<PostgreSQLObsDB> db =
+      itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::Admin);
   return db->getMeasurandInfo(itsParameters.params);
 }
 
@@ -541,7 +627,7 @@ Fmi::DateTime PostgreSQLDatabaseDriverForFmiData::getLatestDataUpdateTime(
     {
       auto database_table = DatabaseDriverBase::resolveDatabaseTableName(
           producer, itsParameters.params->stationtypeConfig);
-      auto db = itsPostgreSQLConnectionPool->getConnection(false);
+      auto db = itsPostgreSQLConnectionPool->getConnection(false, ConnectionPriority::Admin);
       ret = db->getLatestDataUpdateTime(database_table, from, producer_ids, measurand_ids);
     }
 
@@ -61,6 +61,8 @@ class PostgreSQLDatabaseDriverForFmiData : public PostgreSQLDatabaseDriver
 
  private:
   void readConfig(Spine::ConfigBase &cfg);
+  TS::TimeSeriesVectorPtr valuesFromDatabase(Settings &settings);
+  TS::TimeSeriesVectorPtr hybridValues(Settings &settings, ObservationCache &cache);
 };
 
 }  // namespace Observation
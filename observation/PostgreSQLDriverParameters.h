@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ConnectionPriority.h"
 #include "DatabaseDriverParameters.h"
 #include "FmiIoTStation.h"
 #include <boost/make_shared.hpp>
@@ -23,6 +24,7 @@ struct PostgreSQLDriverParameters : public DatabaseDriverParameters
   }
 
   std::vector<Fmi::Database::PostgreSQLConnectionOptions> connectionOptions;
+  ConnectionPriorityLimitsArray connectionPriorityLimits;
   const ExternalAndMobileProducerConfig& externalAndMobileProducerConfig;
   bool loadFmiIoTStations = true;
   std::shared_ptr<FmiIoTStations> fmiIoTStations;
@@ -649,17 +649,21 @@ void PostgreSQLObsDB::fetchWeatherDataQCData(const std::string &sqlStmt,
                                              const StationInfo &stationInfo,
                                              const std::set<std::string> &stationgroup_codes,
                                              const TS::RequestLimits &requestLimits,
+                                             const QueryCancellationPtr &cancellation,
                                              LocationDataItems &cacheData)
 {
   try
   {
-    pqxx::result result_set = itsDB.executeNonTransaction(sqlStmt);
+    pqxx::result result_set = executeCancellable(sqlStmt, cancellation);
 
     std::set<int> fmisids;
     std::set<Fmi::DateTime> obstimes;
+    std::size_t nrows = 0;
     for (auto row : result_set)
     {
       Fmi::AsyncTask::interruption_point();
+      if ((++nrows & 0xfff) == 0)
+        checkCancellation(cancellation);
       std::optional<int> fmisid = as_int(row[0]);
       Fmi::DateTime obstime = Fmi::date_time::from_time_t(row[1].as<time_t>());
       std::optional<std::string> parameter = row[2].as<std::string>();
@@ -769,6 +773,24 @@ std::string PostgreSQLObsDB::sqlSelectFromWeatherDataQCData(const Settings &sett
 }
 
 void PostgreSQLObsDB::getStations(Spine::Stations &stations) const
+{
+  readStations(stations, "", nullptr);
+}
+
+void PostgreSQLObsDB::getStations(Spine::Stations &stations,
+                                  const Fmi::DateTime &modifiedSince,
+                                  std::map<int, Fmi::DateTime> &modifiedStations) const
+{
+  // The window functions are partitioned by station, so filtering whole stations before
+  // them does not change the values of the remaining rows
+  readStations(stations,
+               " AND t.modified_last >= '" + Fmi::to_iso_extended_string(modifiedSince) + "'",
+               &modifiedStations);
+}
+
+void PostgreSQLObsDB::readStations(Spine::Stations &stations,
+                                   const std::string &condition,
+                                   std::map<int, Fmi::DateTime> *modifiedStations) const
 {
   try
   {
@@ -818,7 +840,7 @@ WHERE  tg.group_class_id IN( 1, 81 )
                              'ICE', 'MAGNET', 'MAREO', 'MAST',
                              'PREC', 'RADACT', 'RADAR', 'RESEARCH',
                              'RWS', 'SEA', 'SHIP', 'SOLAR',
-                             'SOUNDING', 'SYNOP', 'HELCOM' )
+                             'SOUNDING', 'SYNOP', 'HELCOM' ))SQL" + condition + R"SQL(
 UNION ALL
 SELECT DISTINCT
        tg.group_code,
@@ -865,7 +887,7 @@ WHERE  tg.group_class_id IN( 1, 81 )
                              'ICE', 'MAGNET', 'MAREO', 'MAST',
                              'PREC', 'RADACT', 'RADAR', 'RESEARCH',
                              'RWS', 'SEA', 'SHIP', 'SOLAR',
-                             'SOUNDING', 'SYNOP', 'HELCOM');)SQL";
+                             'SOUNDING', 'SYNOP', 'HELCOM'))SQL" + condition + ";";
     // clang-format on
 
     if (itsDebug)
@@ -880,6 +902,14 @@ WHERE  tg.group_class_id IN( 1, 81 )
       s.fmisid = as_int(row[1]);
       auto access_policy_id = as_int(row[2]);
 
+      if (modifiedStations != nullptr)
+      {
+        auto modified_last = Fmi::TimeParser::parse(row[20].as<std::string>());
+        auto &latest = (*modifiedStations)[s.fmisid];
+        if (latest.is_not_a_date_time() || modified_last > latest)
+          latest = modified_last;
+      }
+
       // Skip private stations unless EXTRWYWS (runway stations)
       if (access_policy_id != 0 && s.type != "EXTRWYWS")
       {
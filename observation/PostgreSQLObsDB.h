@@ -111,12 +111,18 @@ class PostgreSQLObsDB : public CommonPostgreSQLFunctions
                               const StationInfo &stationInfo,
                               const std::set<std::string> &stationgroup_codes,
                               const TS::RequestLimits &requestLimits,
+                              const QueryCancellationPtr &cancellation,
                               LocationDataItems &weatherDataQCData) override;
   std::string sqlSelectFromWeatherDataQCData(const Settings &settings,
                                              const std::string &params,
                                              const std::string &station_ids) const override;
 
   void getStations(Spine::Stations &stations) const;
+  // Rows of the stations modified at or after the given time. The modification times of all
+  // modified stations are returned even if the station has no public rows left.
+  void getStations(Spine::Stations &stations,
+                   const Fmi::DateTime &modifiedSince,
+                   std::map<int, Fmi::DateTime> &modifiedStations) const;
   void getStationGroups(StationGroups &sg) const;
   void getProducerGroups(ProducerGroups &pg) const;
 
@@ -143,6 +149,9 @@ class PostgreSQLObsDB : public CommonPostgreSQLFunctions
   void readFlashCacheDataFromPostgreSQL(std::vector<FlashDataItem> &flashCacheData,
                                         const std::string &sqlStmt,
                                         const Fmi::TimeZones &timezones);
+  void readStations(Spine::Stations &stations,
+                    const std::string &condition,
+                    std::map<int, Fmi::DateTime> *modifiedStations) const;
 };
 
 }  // namespace Observation
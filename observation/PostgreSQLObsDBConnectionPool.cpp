@@ -2,6 +2,7 @@
 #include "PostgreSQLDriverParameters.h"
 #include <fmt/format.h>
 #include <macgyver/Exception.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -22,6 +23,7 @@ bool PostgreSQLObsDBConnectionPool::addService(
     itsPoolSize += static_cast<unsigned>(poolSize);
     itsWorkingList.resize(itsPoolSize, -1);
     itsWorkerList.resize(itsPoolSize);
+    itsConnectionPriority.resize(itsPoolSize, ConnectionPriority::Interactive);
   }
   catch (...)
   {
@@ -38,6 +40,7 @@ try
     addService(itsParameters.connectionOptions[i], itsParameters.connectionPoolSize[i]);
   }
   setGetConnectionTimeOutSeconds(itsParameters.connectionTimeoutSeconds);
+  setPriorityLimits(itsParameters.connectionPriorityLimits);
 
   return initializePool(itsParameters.params->stationtypeConfig,
                         itsParameters.params->parameterMap);
@@ -94,7 +97,7 @@ bool PostgreSQLObsDBConnectionPool::initializePool(const StationtypeConfig& stc,
 }
 
 std::shared_ptr<PostgreSQLObsDB> PostgreSQLObsDBConnectionPool::getConnection(
-    bool debug /*= false*/)
+    bool debug /*= false*/, ConnectionPriority priority /*= ConnectionPriority::Interactive*/)
 {
   try
   {
@@ -104,8 +107,10 @@ std::shared_ptr<PostgreSQLObsDB> PostgreSQLObsDBConnectionPool::getConnection(
      *
      * Logic of returning connections:
      *
-     * 1. Check if worker is idle, if so return that worker.
-     * 2. Sleep and start over
+     * 1. Check the priority class is below its maximum share and that taking a connection
+     *    does not eat into the reservations of the other classes
+     * 2. Check if worker is idle, if so return that worker.
+     * 3. Sleep and start over
      */
     size_t countTimeOut = 0;
     auto failures = 0;
@@ -114,27 +119,37 @@ std::shared_ptr<PostgreSQLObsDB> PostgreSQLObsDBConnectionPool::getConnection(
       // Local scope to minimize lock life time
       {
         Spine::WriteLock lock(itsGetMutex);
-        for (std::size_t i = 0; i < itsWorkingList.size(); i++)
-        {
-          // We try the connections after the last taken one to go through all the members more
-          // efficiently to keep the connections alive
-          auto pos = (i + itsLastConnectionID + 1) % itsWorkingList.size();
 
-          if (itsWorkingList[pos] == 0)
+        const auto freeConnections = static_cast<std::size_t>(
+            std::count(itsWorkingList.begin(), itsWorkingList.end(), 0));
+
+        if (priorityAllows(priority, freeConnections))
+        {
+          for (std::size_t i = 0; i < itsWorkingList.size(); i++)
           {
-            itsWorkingList[pos] = 1;
-            itsWorkerList[pos]->setConnectionId(pos);
-            itsWorkerList[pos]->setDebug(debug);
-            itsLastConnectionID = pos;
-            if (failures > 0)
-              std::cerr << fmt::format(
-                  "Success: after {} failure(s) got a free connection from the PostgreSQL "
-                  "connection pool\n",
-                  failures);
-
-            return {itsWorkerList[pos].get(),
-                    [this](PostgreSQLObsDB* t) -> void
-                    { this->releaseConnection(t->connectionId()); }};
+            // We try the connections after the last taken one to go through all the members more
+            // efficiently to keep the connections alive
+            auto pos = (i + itsLastConnectionID + 1) % itsWorkingList.size();
+
+            if (itsWorkingList[pos] == 0)
+            {
+              itsWorkingList[pos] = 1;
+              itsConnectionPriority[pos] = priority;
+              ++itsActiveConnections[priorityIndex(priority)];
+              itsWorkerList[pos]->setConnectionId(pos);
+              itsWorkerList[pos]->setDebug(debug);
+              itsLastConnectionID = pos;
+              if (failures > 0)
+                std::cerr << fmt::format(
+                    "Success: after {} failure(s) got a free connection from the PostgreSQL "
+                    "connection pool for priority class {}\n",
+                    failures,
+                    priorityName(priority));
+
+              return {itsWorkerList[pos].get(),
+                      [this](PostgreSQLObsDB* t) -> void
+                      { this->releaseConnection(t->connectionId()); }};
+            }
           }
         }
       }
@@ -143,11 +158,15 @@ std::shared_ptr<PostgreSQLObsDB> PostgreSQLObsDBConnectionPool::getConnection(
       if (++countTimeOut > itsGetConnectionTimeOutSeconds)
       {
         throw Fmi::Exception(
-            BCP, "Could not get a database connection. All the database connections are in use!");
+            BCP, "Could not get a database connection. All the database connections are in use!")
+            .addParameter("Priority class", priorityName(priority));
       }
 
       if (failures++ == 0)
-        std::cerr << "Warning: failed to get a connection from the PostgreSQL connection pool\n";
+        std::cerr << fmt::format(
+            "Warning: failed to get a connection from the PostgreSQL connection pool for priority "
+            "class {}\n",
+            priorityName(priority));
 
       // The timeout counter above assumes the sleep time here is one second. Should be rewritten.
       boost::this_thread::sleep_for(boost::chrono::milliseconds(1000));
@@ -163,6 +182,37 @@ std::shared_ptr<PostgreSQLObsDB> PostgreSQLObsDBConnectionPool::getConnection(
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a priority class may take one of the free connections
+ *
+ * The class must be below its maximum share of the pool, and after taking the
+ * connection there must still be enough free connections to satisfy the unused
+ * reservations of the other classes. Must be called with itsGetMutex held.
+ */
+// ----------------------------------------------------------------------
+
+bool PostgreSQLObsDBConnectionPool::priorityAllows(ConnectionPriority priority,
+                                                   std::size_t freeConnections) const
+{
+  const auto index = priorityIndex(priority);
+
+  if (itsActiveConnections[index] >= itsPriorityMaxConnections[index])
+    return false;
+
+  std::size_t reservedForOthers = 0;
+  for (std::size_t i = 0; i < CONNECTION_PRIORITY_COUNT; i++)
+  {
+    if (i == index)
+      continue;
+    const std::size_t active = itsActiveConnections[i];
+    if (active < itsPriorityLimits[i].reserved)
+      reservedForOthers += itsPriorityLimits[i].reserved - active;
+  }
+
+  return freeConnections > reservedForOthers;
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Shutdown connections
@@ -204,8 +254,11 @@ void PostgreSQLObsDBConnectionPool::releaseConnection(int connectionId)
 
     // Do "destructor" stuff here, because PostgreSQL instances are never destructed
 
-    // Release the worker to the pool
-    itsWorkingList.at(static_cast<unsigned>(connectionId)) = 0;
+    // Release the worker to the pool. The priority class count is decremented first so that
+    // a competing getConnection never sees the slot free while the class still looks busy.
+    const auto pos = static_cast<unsigned>(connectionId);
+    --itsActiveConnections[priorityIndex(itsConnectionPriority.at(pos))];
+    itsWorkingList.at(pos) = 0;
   }
   catch (...)
   {
@@ -221,6 +274,36 @@ void PostgreSQLObsDBConnectionPool::setGetConnectionTimeOutSeconds(std::size_t s
   itsGetConnectionTimeOutSeconds = seconds;
 }
 
+void PostgreSQLObsDBConnectionPool::setPriorityLimits(const ConnectionPriorityLimitsArray& limits)
+{
+  try
+  {
+    std::size_t totalReserved = 0;
+    for (const auto& limit : limits)
+      totalReserved += limit.reserved;
+
+    if (totalReserved >= itsPoolSize && totalReserved > 0)
+      throw Fmi::Exception(BCP, "Reserved connections must leave at least one shared connection")
+          .addParameter("reserved", Fmi::to_string(totalReserved))
+          .addParameter("poolSize", Fmi::to_string(itsPoolSize));
+
+    itsPriorityLimits = limits;
+
+    // A class may always use at least its own reservation, and at least one connection so that
+    // a misconfigured share never blocks a class completely
+    for (std::size_t i = 0; i < CONNECTION_PRIORITY_COUNT; i++)
+    {
+      const auto& limit = itsPriorityLimits[i];
+      auto maxConnections = itsPoolSize * std::min<std::size_t>(limit.maxPercentage, 100) / 100;
+      itsPriorityMaxConnections[i] = std::max<std::size_t>({maxConnections, limit.reserved, 1});
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Invalid PostgreSQL connection priority settings!");
+  }
+}
+
 }  // namespace Observation
 }  // namespace Engine
 }  // namespace SmartMet
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "ConnectionPriority.h"
 #include "PostgreSQLObsDB.h"
 #include <macgyver/PostgreSQLConnection.h>
 #include <spine/Thread.h>
+#include <atomic>
 
 namespace SmartMet
 {
@@ -25,7 +27,8 @@ class PostgreSQLObsDBConnectionPool
 
   bool initializePool(const PostgreSQLDriverParameters& itsParameters);
 
-  std::shared_ptr<PostgreSQLObsDB> getConnection(bool debug);
+  std::shared_ptr<PostgreSQLObsDB> getConnection(
+      bool debug, ConnectionPriority priority = ConnectionPriority::Interactive);
 
   void shutdown();
 
@@ -43,6 +46,10 @@ class PostgreSQLObsDBConnectionPool
    */
   void setGetConnectionTimeOutSeconds(std::size_t seconds);
 
+  void setPriorityLimits(const ConnectionPriorityLimitsArray& limits);
+
+  bool priorityAllows(ConnectionPriority priority, std::size_t freeConnections) const;
+
   std::vector<int> itsWorkingList;
   std::vector<std::shared_ptr<PostgreSQLObsDB> > itsWorkerList;
   Spine::MutexType itsGetMutex;
@@ -51,6 +58,13 @@ class PostgreSQLObsDBConnectionPool
   std::size_t itsPoolSize = 0;
   std::size_t itsLastConnectionID = 0;  // for rotating through the pool frequently
   std::size_t itsGetConnectionTimeOutSeconds = 30;
+
+  // Priority class bookkeeping. The class which took a connection is remembered so that
+  // releaseConnection can update the active counts without locking.
+  ConnectionPriorityLimitsArray itsPriorityLimits;
+  std::array<std::size_t, CONNECTION_PRIORITY_COUNT> itsPriorityMaxConnections{};
+  std::array<std::atomic<std::size_t>, CONNECTION_PRIORITY_COUNT> itsActiveConnections{};
+  std::vector<ConnectionPriority> itsConnectionPriority;
 };
 
 }  // namespace Observation
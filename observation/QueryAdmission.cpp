@@ -0,0 +1,166 @@
+#include "QueryAdmission.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+// Weight of the new sample in the moving average of samples per hour
+const double sample_weight = 0.1;
+
+double query_hours(const Settings& settings)
+{
+  if (settings.endtime <= settings.starttime)
+    return 0;
+  return static_cast<double>((settings.endtime - settings.starttime).total_seconds()) / 3600.0;
+}
+
+}  // anonymous namespace
+
+QueryAdmission::Permit::~Permit()
+{
+  if (itsAdmission != nullptr && itsWeight > 0)
+    itsAdmission->release(itsWeight);
+}
+
+std::size_t QueryAdmission::estimate(const Settings& settings,
+                                     std::size_t nstations,
+                                     unsigned int timestep) const
+{
+  try
+  {
+    double samples = itsLimits.samplesPerHour;
+    if (timestep > 0)
+      samples = 60.0 / timestep;
+    else
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      auto pos = itsSamplesPerHour.find(settings.stationtype);
+      if (pos != itsSamplesPerHour.end())
+        samples = pos->second;
+    }
+
+    // There is at least one row per station, for example when querying the latest observation
+    const double rows = std::max(1.0, query_hours(settings) * samples);
+    const auto nparams = std::max<std::size_t>(1, settings.parameters.size());
+    const double values =
+        std::ceil(static_cast<double>(nstations) * static_cast<double>(nparams) * rows);
+
+    if (values >= static_cast<double>(std::numeric_limits<std::size_t>::max()))
+      return std::numeric_limits<std::size_t>::max();
+    return static_cast<std::size_t>(values);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::unique_ptr<QueryAdmission::Permit> QueryAdmission::admit(const Settings& settings,
+                                                              std::size_t estimatedValues)
+{
+  try
+  {
+    if (itsLimits.maxValues > 0 && estimatedValues > itsLimits.maxValues)
+    {
+      Fmi::Exception ex(BCP, "The estimated size of the query exceeds the allowed limit");
+      ex.addParameter("Estimated values", Fmi::to_string(estimatedValues));
+      ex.addParameter("Limit", Fmi::to_string(itsLimits.maxValues));
+      ex.disableStackTrace();
+      throw ex;
+    }
+
+    if (!isLimitingHeavyQueries() || estimatedValues < itsLimits.heavyQueryValues)
+      return std::make_unique<Permit>(nullptr, 0);
+
+    // Weight is the number of weight units of the query rounded up, and a single query may
+    // always run alone
+    const std::size_t units =
+        (estimatedValues + itsLimits.heavyQueryValues - 1) / itsLimits.heavyQueryValues;
+    const std::size_t weight = std::min(units, itsLimits.maxHeavyQueryWeight);
+
+    using Clock = std::chrono::steady_clock;
+    auto deadline = Clock::now() + std::chrono::milliseconds(itsLimits.queueTimeout);
+    if (settings.cancellation)
+    {
+      const auto remaining = settings.cancellation->remaining();
+      if (remaining)
+        deadline = std::min(deadline, Clock::now() + *remaining);
+    }
+
+    std::unique_lock<std::mutex> lock(itsMutex);
+    while (itsUsedWeight + weight > itsLimits.maxHeavyQueryWeight)
+    {
+      // Wake up regularly to notice cancelled queries
+      const auto wakeup = std::min(deadline, Clock::now() + std::chrono::milliseconds(100));
+      itsCondition.wait_until(lock, wakeup);
+
+      if (isCancelled(settings.cancellation))
+      {
+        lock.unlock();
+        checkCancellation(settings.cancellation);
+      }
+
+      if (Clock::now() >= deadline && itsUsedWeight + weight > itsLimits.maxHeavyQueryWeight)
+      {
+        Fmi::Exception ex(BCP, "Too many heavy queries running, try again later");
+        ex.addParameter("Estimated values", Fmi::to_string(estimatedValues));
+        ex.disableStackTrace();
+        throw ex;
+      }
+    }
+
+    itsUsedWeight += weight;
+    return std::make_unique<Permit>(this, weight);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void QueryAdmission::record(const Settings& settings, std::size_t nstations, std::size_t nrows)
+{
+  try
+  {
+    // Short queries say little about the sampling rate
+    const double hours = query_hours(settings);
+    if (nstations == 0 || nrows == 0 || hours < 1)
+      return;
+
+    const double samples = static_cast<double>(nrows) / (static_cast<double>(nstations) * hours);
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+    auto pos = itsSamplesPerHour.find(settings.stationtype);
+    if (pos == itsSamplesPerHour.end())
+      itsSamplesPerHour.emplace(settings.stationtype, samples);
+    else
+      pos->second = (1 - sample_weight) * pos->second + sample_weight * samples;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void QueryAdmission::release(std::size_t weight)
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsUsedWeight -= std::min(weight, itsUsedWeight);
+  }
+  itsCondition.notify_all();
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Settings.h"
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Admission control of values() queries. The number of values in the result is estimated
+// before the query is run as stations x parameters x hours x samples per hour. The number of
+// samples follows from the timestep if the result is on a fixed time grid, otherwise it is
+// learned per stationtype from the completed queries which return all data. Queries estimated
+// to be too large are rejected, and heavy queries share a weighted semaphore so that only a
+// few of them run concurrently.
+
+struct QueryAdmissionLimits
+{
+  std::size_t maxValues = 0;            // reject larger queries, 0 = unlimited
+  std::size_t heavyQueryValues = 0;     // weight unit of heavy queries, 0 = disabled
+  std::size_t maxHeavyQueryWeight = 0;  // total weight of concurrent heavy queries
+  int queueTimeout = 10000;             // milliseconds to wait for a permit
+  double samplesPerHour = 6;            // initial estimate for each stationtype
+};
+
+class QueryAdmission
+{
+ public:
+  // Returns the weight to the semaphore when destroyed
+  class Permit
+  {
+   public:
+    Permit(QueryAdmission* admission, std::size_t weight)
+        : itsAdmission(admission), itsWeight(weight)
+    {
+    }
+    ~Permit();
+
+    Permit(const Permit& other) = delete;
+    Permit(Permit&& other) = delete;
+    Permit& operator=(const Permit& other) = delete;
+    Permit& operator=(Permit&& other) = delete;
+
+   private:
+    QueryAdmission* itsAdmission = nullptr;
+    std::size_t itsWeight = 0;
+  };
+
+  explicit QueryAdmission(const QueryAdmissionLimits& limits) : itsLimits(limits) {}
+
+  bool enabled() const { return itsLimits.maxValues > 0 || isLimitingHeavyQueries(); }
+
+  // Estimated number of values in the result of a query for the given number of stations.
+  // A nonzero timestep in minutes means the result is on a fixed time grid.
+  std::size_t estimate(const Settings& settings,
+                       std::size_t nstations,
+                       unsigned int timestep = 0) const;
+
+  // Throws if the estimate exceeds the limit or if no permit is available before the queue
+  // timeout, the deadline of the query or its cancellation
+  std::unique_ptr<Permit> admit(const Settings& settings, std::size_t estimatedValues);
+
+  // Update the samples per hour estimate of the stationtype from a completed query which
+  // returned all the data in the time interval
+  void record(const Settings& settings, std::size_t nstations, std::size_t nrows);
+
+ private:
+  bool isLimitingHeavyQueries() const
+  {
+    return itsLimits.heavyQueryValues > 0 && itsLimits.maxHeavyQueryWeight > 0;
+  }
+
+  void release(std::size_t weight);
+
+  const QueryAdmissionLimits itsLimits;
+
+  mutable std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  std::size_t itsUsedWeight = 0;
+  std::map<std::string, double> itsSamplesPerHour;  // stationtype
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
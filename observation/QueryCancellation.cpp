@@ -0,0 +1,103 @@
+#include "QueryCancellation.h"
+#include <macgyver/Exception.h>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+void QueryCancellation::cancel()
+{
+  try
+  {
+    if (itsCancelled.exchange(true))
+      return;
+
+    // Run the callbacks while holding the lock so that a registration cannot be
+    // destroyed while its callback is running
+    std::lock_guard<std::mutex> lock(itsMutex);
+    for (const auto& item : itsCallbacks)
+    {
+      try
+      {
+        item.second();
+      }
+      catch (...)
+      {
+        // Interrupting a statement is best effort only
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+bool QueryCancellation::cancelled() const
+{
+  if (itsCancelled)
+    return true;
+  return (itsDeadline && Clock::now() >= *itsDeadline);
+}
+
+void QueryCancellation::check() const
+{
+  if (itsCancelled)
+    throw Fmi::Exception(BCP, "Query cancelled").disableStackTrace();
+
+  if (itsDeadline && Clock::now() >= *itsDeadline)
+    throw Fmi::Exception(BCP, "Query deadline exceeded").disableStackTrace();
+}
+
+std::optional<std::chrono::milliseconds> QueryCancellation::remaining() const
+{
+  if (!itsDeadline)
+    return {};
+
+  const auto left = *itsDeadline - Clock::now();
+  if (left <= Clock::duration::zero())
+    return std::chrono::milliseconds(0);
+  return std::chrono::duration_cast<std::chrono::milliseconds>(left);
+}
+
+std::unique_ptr<QueryCancellation::Registration> QueryCancellation::onCancel(Callback callback)
+{
+  try
+  {
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      if (!itsCancelled)
+      {
+        const auto id = itsNextId++;
+        itsCallbacks.emplace(id, std::move(callback));
+        return std::make_unique<Registration>(this, id);
+      }
+    }
+
+    callback();
+    return std::make_unique<Registration>();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void QueryCancellation::unregister(std::size_t id)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  itsCallbacks.erase(id);
+}
+
+QueryCancellation::Registration::~Registration()
+{
+  if (itsToken != nullptr)
+    itsToken->unregister(itsId);
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
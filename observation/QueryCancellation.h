@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Deadline and cancellation token of a single query. The caller keeps a reference to the
+// token and may cancel the query from another thread, for example when the client
+// disconnects. The scan loops poll the token, and the database drivers register callbacks
+// for interrupting statements which are already executing in the database.
+
+class QueryCancellation
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  QueryCancellation() = default;
+  explicit QueryCancellation(Clock::duration timeout) : itsDeadline(Clock::now() + timeout) {}
+
+  QueryCancellation(const QueryCancellation& other) = delete;
+  QueryCancellation(QueryCancellation&& other) = delete;
+  QueryCancellation& operator=(const QueryCancellation& other) = delete;
+  QueryCancellation& operator=(QueryCancellation&& other) = delete;
+
+  // Cancel the query and run the registered interrupt callbacks
+  void cancel();
+
+  // True if the query has been cancelled or the deadline has passed
+  bool cancelled() const;
+
+  // Throws if the query has been cancelled or the deadline has passed
+  void check() const;
+
+  // Time left until the deadline, or nullopt if there is no deadline
+  std::optional<std::chrono::milliseconds> remaining() const;
+
+  // Registers a callback run by cancel() for as long as the returned object is alive. The
+  // callback is run immediately if the query has already been cancelled.
+  class Registration
+  {
+   public:
+    Registration() = default;
+    Registration(QueryCancellation* token, std::size_t id) : itsToken(token), itsId(id) {}
+    ~Registration();
+
+    Registration(const Registration& other) = delete;
+    Registration(Registration&& other) = delete;
+    Registration& operator=(const Registration& other) = delete;
+    Registration& operator=(Registration&& other) = delete;
+
+   private:
+    QueryCancellation* itsToken = nullptr;
+    std::size_t itsId = 0;
+  };
+
+  std::unique_ptr<Registration> onCancel(Callback callback);
+
+ private:
+  void unregister(std::size_t id);
+
+  std::atomic<bool> itsCancelled{false};
+  std::optional<Clock::time_point> itsDeadline;
+
+  std::mutex itsMutex;
+  std::size_t itsNextId = 1;
+  std::map<std::size_t, Callback> itsCallbacks;
+};
+
+using QueryCancellationPtr = std::shared_ptr<QueryCancellation>;
+
+// Convenience functions for the optional token in Settings. A missing token never expires.
+
+inline bool isCancelled(const QueryCancellationPtr& token)
+{
+  return token && token->cancelled();
+}
+
+inline void checkCancellation(const QueryCancellationPtr& token)
+{
+  if (token)
+    token->check();
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -1,4 +1,8 @@
 #include "Settings.h"
+#include <fmt/format.h>
+#include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
+#include <string>
 
 namespace SmartMet
 {
@@ -17,8 +21,141 @@ void print_vector(const std::vector<int>& data, const std::string& header, std::
   for (auto i : data)
     out << i << '\n';
 }
+
+// Appends a length prefixed field so that keys of different settings can never be equal
+void add_key(std::string& key, const std::string& value)
+{
+  key += std::to_string(value.size());
+  key += ':';
+  key += value;
+}
+
+void add_key(std::string& key, const Fmi::DateTime& value)
+{
+  add_key(key, value.is_not_a_date_time() ? std::string("-") : Fmi::to_iso_string(value));
+}
+
+template <typename T>
+void add_key(std::string& key, const T& value)
+{
+  add_key(key, fmt::format("{}", value));
+}
+
+void add_filter_key(std::string& key, const TS::DataFilter& filter, const std::string& name)
+{
+  if (filter.exist(name))
+  {
+    add_key(key, name);
+    add_key(key, filter.getSqlClause(name, name));
+  }
+}
 }  // anonymous namespace
 
+std::string Settings::key() const
+{
+  try
+  {
+    std::string key;
+    add_key(key, stationtype);
+    add_key(key, stationtype_specifier);
+
+    add_key(key, parameters.size());
+    for (const auto& p : parameters)
+    {
+      add_key(key, p.name());
+      add_key(key, static_cast<int>(p.type()));
+      add_key(key, p.getSensorNumber() ? *p.getSensorNumber() : -1);
+      add_key(key, p.getSensorParameter());
+    }
+
+    add_key(key, taggedLocations.size());
+    for (const auto& l : taggedLocations)
+    {
+      add_key(key, l.tag);
+      add_key(key, l.loc ? Spine::formatLocation(*l.loc) : std::string("-"));
+    }
+
+    add_key(key, taggedFMISIDs.size());
+    for (const auto& item : taggedFMISIDs)
+    {
+      add_key(key, item.tag);
+      add_key(key, item.fmisid);
+      add_key(key, item.direction);
+      add_key(key, item.distance);
+    }
+
+    add_key(key, hours.size());
+    for (auto h : hours)
+      add_key(key, h);
+    add_key(key, weekdays.size());
+    for (auto w : weekdays)
+      add_key(key, w);
+
+    add_key(key, boundingBox.size());
+    for (const auto& item : boundingBox)
+    {
+      add_key(key, item.first);
+      add_key(key, item.second);
+    }
+
+    add_filter_key(key, dataFilter, "data_quality");
+    add_filter_key(key, dataFilter, "station_id");
+
+    add_key(key, producer_ids.size());
+    for (auto id : producer_ids)
+      add_key(key, id);
+    add_key(key, stationgroups.size());
+    for (const auto& group : stationgroups)
+      add_key(key, group);
+
+    add_key(key, locale.name());
+    add_key(key, cacheKey);
+    add_key(key, format);
+    add_key(key, language);
+    add_key(key, localename);
+    add_key(key, missingtext);
+    add_key(key, timeformat);
+    add_key(key, timestring);
+    add_key(key, timezone);
+    add_key(key, wktArea);
+    add_key(key, starttime);
+    add_key(key, endtime);
+    add_key(key, wantedtime ? *wantedtime : Fmi::DateTime());
+    add_key(key, aggregation ? aggregation->interval : 0);
+    add_key(key, aggregation ? static_cast<int>(aggregation->function) : -1);
+    add_key(key, maxdistance);
+    add_key(key, numberofstations);
+    add_key(key, timestep);
+    add_key(key, allplaces);
+    add_key(key, starttimeGiven);
+    add_key(key, useCommonQueryMethod);
+    add_key(key, useDataCache);
+    add_key(key, preventDatabaseQuery);
+    add_key(key, requestLimits.maxlocations);
+    add_key(key, requestLimits.maxparameters);
+    add_key(key, requestLimits.maxtimes);
+    add_key(key, requestLimits.maxlevels);
+    add_key(key, requestLimits.maxelements);
+    return key;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Failed to get key for Settings!");
+  }
+}
+
+std::size_t Settings::hash_value() const
+{
+  try
+  {
+    return Fmi::hash_value(key());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Failed to get hash_value for Settings!");
+  }
+}
+
 std::ostream& operator<<(std::ostream& out, const Engine::Observation::Settings& settings)
 {
   if (!settings.parameters.empty())
@@ -100,6 +237,21 @@ std::ostream& operator<<(std::ostream& out, const Engine::Observation::Settings&
     out << "wantedtime: " << *settings.wantedtime << '\n';
   else
     out << "wantedtime: -\n";
+  if (settings.aggregation)
+    out << "aggregation: " << static_cast<int>(settings.aggregation->function) << '/'
+        << settings.aggregation->interval << '\n';
+  else
+    out << "aggregation: -\n";
+  if (settings.cancellation)
+  {
+    const auto left = settings.cancellation->remaining();
+    out << "cancellation: " << (settings.cancellation->cancelled() ? "cancelled" : "active");
+    if (left)
+      out << ", " << left->count() << " ms left";
+    out << '\n';
+  }
+  else
+    out << "cancellation: -\n";
   out << "maxdistance: " << settings.maxdistance << '\n';
   out << "numberofstations: " << settings.numberofstations << '\n';
   out << "timestep: " << settings.timestep << '\n';
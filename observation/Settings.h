@@ -1,5 +1,6 @@
 #pragma once
 
+#include "QueryCancellation.h"
 #include <macgyver/DateTime.h>
 #include <macgyver/ValueFormatter.h>
 #include <spine/Location.h>
@@ -17,6 +18,23 @@ namespace Engine
 {
 namespace Observation
 {
+// Aggregation of raw observations into time buckets evaluated by the caches. A bucket of
+// length interval minutes ending at time t contains the observations in (t-interval,t],
+// buckets end at multiples of the interval counted from the epoch.
+struct AggregationSpec
+{
+  enum class Function
+  {
+    Min,
+    Max,
+    Mean,
+    Sum
+  };
+
+  Function function = Function::Mean;
+  int interval = 60;  // minutes
+};
+
 class Settings
 {
  public:
@@ -60,6 +78,12 @@ class Settings
   // end time if one wants the latest observation.
   std::optional<Fmi::DateTime> wantedtime;
 
+  // Return only aggregated rows, one per station, measurand, sensor and time bucket
+  std::optional<AggregationSpec> aggregation;
+
+  // Deadline and cancellation token checked while the query is running. Not part of the hash.
+  QueryCancellationPtr cancellation;
+
   double maxdistance = 50000;
   int numberofstations = 1;
   int timestep = 1;
@@ -71,6 +95,14 @@ class Settings
   TS::RequestLimits requestLimits;
   // 0 or more bits from DebugOptions to enable debugging features
   uint32_t debug_options = 0;
+
+  // Canonical text of the settings which affect the query result. Unlike the hash, equal
+  // keys imply identical queries. Data filters other than data_quality and station_id are
+  // not included.
+  std::string key() const;
+
+  // Hash of key()
+  std::size_t hash_value() const;
 };
 
 std::ostream& operator<<(std::ostream& out, const Settings& settings);
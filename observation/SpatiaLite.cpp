@@ -1,4 +1,6 @@
 #include "SpatiaLite.h"
+#include "Aggregation.h"
+#include "DataCoverage.h"
 #include "DataWithQuality.h"
 #include "ExternalAndMobileDBInfo.h"
 #include "Keywords.h"
@@ -177,6 +179,43 @@ void bindAndExecuteMobileExternalItem(sqlite3pp::database &db,
   cmd.execute();
   cmd.reset();
 }
+
+// Aborts the running statement with SQLITE_INTERRUPT once the query has been cancelled or its
+// deadline has passed. SQLite polls the handler every given number of virtual machine
+// instructions, hence also long sorts done before the first row is returned are interrupted.
+
+int cancellation_progress_handler(void *token)
+{
+  return static_cast<const QueryCancellation *>(token)->cancelled() ? 1 : 0;
+}
+
+class CancellationGuard
+{
+ public:
+  CancellationGuard(sqlite3pp::database &db, QueryCancellationPtr token)
+      : itsDB(db), itsToken(std::move(token))
+  {
+    if (itsToken)
+      sqlite_api::sqlite3_progress_handler(
+          itsDB.sqlite3_handle(), 10000, cancellation_progress_handler, itsToken.get());
+  }
+
+  ~CancellationGuard()
+  {
+    if (itsToken)
+      sqlite_api::sqlite3_progress_handler(itsDB.sqlite3_handle(), 0, nullptr, nullptr);
+  }
+
+  CancellationGuard(const CancellationGuard &other) = delete;
+  CancellationGuard(CancellationGuard &&other) = delete;
+  CancellationGuard &operator=(const CancellationGuard &other) = delete;
+  CancellationGuard &operator=(CancellationGuard &&other) = delete;
+
+ private:
+  sqlite3pp::database &itsDB;
+  QueryCancellationPtr itsToken;
+};
+
 }  // namespace
 
 // Results read from the sqlite database
@@ -208,14 +247,34 @@ LocationDataItems SpatiaLite::readObservationDataFromDB(
     auto starttime = to_epoch(settings.starttime);
     auto endtime = to_epoch(settings.endtime);
 
-    std::string sqlStmt =
-        "SELECT data.fmisid AS fmisid, data.sensor_no AS sensor_no, data.data_time AS obstime, "
-        "measurand_id, measurand_no, data_value, data_quality, data_source FROM observation_data "
-        "data "
-        "WHERE data.fmisid IN (" +
-        stationsql +
-        ") "
-        "AND data.data_time";
+    // Read only complete buckets. The times are whole seconds, hence the bucket start itself
+    // is excluded by starting one second later.
+    if (settings.aggregation)
+    {
+      starttime = to_epoch(aggregationStartTime(settings.starttime, *settings.aggregation)) + 1;
+      endtime = to_epoch(aggregationEndTime(settings.endtime, *settings.aggregation));
+      if (endtime < starttime)
+        return ret;
+    }
+
+    std::string sqlStmt;
+    if (!settings.aggregation)
+      sqlStmt =
+          "SELECT data.fmisid AS fmisid, data.sensor_no AS sensor_no, data.data_time AS obstime, "
+          "measurand_id, measurand_no, data_value, data_quality, data_source ";
+    else
+    {
+      // Aggregate into time buckets ending at multiples of the bucket length
+      const auto bucket = Fmi::to_string(aggregationBucketSeconds(*settings.aggregation));
+      sqlStmt = "SELECT data.fmisid AS fmisid, data.sensor_no AS sensor_no, ((data.data_time + " +
+                bucket + " - 1) / " + bucket + ") * " + bucket +
+                " AS obstime, measurand_id, measurand_no, " +
+                aggregationSqlFunction(*settings.aggregation) +
+                "(data_value), MAX(data_quality), MAX(data_source) ";
+    }
+    sqlStmt += "FROM observation_data data WHERE data.fmisid IN (" + stationsql +
+               ") "
+               "AND data.data_time";
 
     if (starttime == endtime)
       sqlStmt += "=" + Fmi::to_string(starttime);
@@ -227,12 +286,15 @@ LocationDataItems SpatiaLite::readObservationDataFromDB(
       sqlStmt += ("AND data.producer_id IN (" + producersql + ") ");
 
     sqlStmt += getSensorQueryCondition(qmap.sensorNumberToMeasurandIds);
-    sqlStmt += "AND " + settings.dataFilter.getSqlClause("data_quality", "data.data_quality") +
-               "ORDER BY fmisid ASC, obstime ASC";
+    sqlStmt += "AND " + settings.dataFilter.getSqlClause("data_quality", "data.data_quality");
+    if (settings.aggregation)
+      sqlStmt += " GROUP BY 1, 2, 3, 4, 5 ";
+    sqlStmt += "ORDER BY fmisid ASC, obstime ASC";
 
     if (itsDebug)
       std::cout << "SpatiaLite: " << sqlStmt << '\n';
 
+    CancellationGuard guard(itsDB, settings.cancellation);
     sqlite3pp::query qry(itsDB, sqlStmt.c_str());
 
     std::set<int> fmisids;
@@ -286,6 +348,8 @@ LocationDataItems SpatiaLite::readObservationDataFromDB(
   }
   catch (...)
   {
+    // Report an interrupted statement as a cancellation
+    checkCancellation(settings.cancellation);
     throw Fmi::Exception::Trace(BCP, "Reading observations from sqlite database failed!");
   }
 }
@@ -2963,6 +3027,19 @@ TS::TimeSeriesVectorPtr SpatiaLite::getObservationData(
 
     auto qmap = buildQueryMapping(settings, stationtype, false);
 
+    // Skip stations and measurands which have no data in the requested interval
+
+    Spine::Stations covered_stations;
+    const Spine::Stations *query_stations = &stations;
+
+    if (itsDataCoverage != nullptr && itsDataCoverage->complete())
+    {
+      covered_stations = stations;
+      itsDataCoverage->prune(
+          covered_stations, qmap.measurandIds, settings.starttime, settings.endtime);
+      query_stations = &covered_stations;
+    }
+
     // Should we use the cache?
 
     bool use_memory_cache = (observationMemoryCache != nullptr);
@@ -2974,11 +3051,14 @@ TS::TimeSeriesVectorPtr SpatiaLite::getObservationData(
           (!cache_start_time.is_not_a_date_time() && cache_start_time <= settings.starttime);
     }
 
-    LocationDataItems observations =
-        (use_memory_cache ? observationMemoryCache->read_observations(
-                                stations, settings, stationInfo, settings.stationgroups, qmap)
-                          : readObservationDataFromDB(
-                                stations, settings, stationInfo, qmap, settings.stationgroups));
+    LocationDataItems observations;
+    if (!query_stations->empty() && !qmap.measurandIds.empty())
+      observations =
+          (use_memory_cache
+               ? observationMemoryCache->read_observations(
+                     *query_stations, settings, stationInfo, settings.stationgroups, qmap)
+               : readObservationDataFromDB(
+                     *query_stations, settings, stationInfo, qmap, settings.stationgroups));
 
     std::set<int> observed_fmisids;
     for (const auto &item : observations)
@@ -3080,6 +3160,7 @@ LocationDataItems SpatiaLite::readObservationDataOfMovingStationsFromDB(
     if (itsDebug)
       std::cout << "SpatiaLite: " << sqlStmt << '\n';
 
+    CancellationGuard guard(itsDB, settings.cancellation);
     sqlite3pp::query qry(itsDB, sqlStmt.c_str());
 
     for (const auto &row : qry)
@@ -3105,10 +3186,15 @@ LocationDataItems SpatiaLite::readObservationDataOfMovingStationsFromDB(
       ret.emplace_back(obs);
     }
 
+    if (settings.aggregation)
+      return aggregateObservations(
+          ret, *settings.aggregation, settings.starttime, settings.endtime);
+
     return ret;
   }
   catch (...)
   {
+    checkCancellation(settings.cancellation);
     throw Fmi::Exception::Trace(BCP, "Fetching data from SpatiaLite database failed!");
   }
 }
@@ -3164,6 +3250,34 @@ void SpatiaLite::initObservationMemoryCache(
   }
 }
 
+void SpatiaLite::initDataCoverage(DataCoverage &coverage)
+{
+  try
+  {
+    std::string sql =
+        "SELECT fmisid, measurand_id, MIN(data_time), MAX(data_time) FROM observation_data "
+        "GROUP BY fmisid, measurand_id";
+
+    sqlite3pp::query qry(itsDB, sql.c_str());
+
+    for (const auto &row : qry)
+    {
+      time_t first = row.get<int>(2);
+      time_t last = row.get<int>(3);
+      coverage.add(row.get<int>(0),
+                   row.get<int>(1),
+                   Fmi::date_time::from_time_t(first),
+                   Fmi::date_time::from_time_t(last));
+    }
+
+    coverage.setComplete();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Initializing observation data coverage failed!");
+  }
+}
+
 void SpatiaLite::initExtMemoryCache(const Fmi::DateTime &starttime,
                                     const std::unique_ptr<ObservationMemoryCache> &extMemoryCache)
 {
@@ -3218,16 +3332,22 @@ void SpatiaLite::fetchWeatherDataQCData(const std::string &sqlStmt,
                                         const StationInfo &stationInfo,
                                         const std::set<std::string> &stationgroup_codes,
                                         const TS::RequestLimits &requestLimits,
+                                        const QueryCancellationPtr &cancellation,
                                         LocationDataItems &cacheData)
 {
   try
   {
+    CancellationGuard guard(itsDB, cancellation);
     sqlite3pp::query qry(itsDB, sqlStmt.c_str());
 
     std::set<int> fmisids;
     std::set<Fmi::DateTime> obstimes;
+    std::size_t nrows = 0;
     for (const auto &row : qry)
     {
+      if ((++nrows & 0xfff) == 0)
+        checkCancellation(cancellation);
+
       int fmisid = row.get<int>(0);
       unsigned int obstime_db = row.get<int>(1);
       Fmi::DateTime obstime = Fmi::date_time::from_time_t(obstime_db);
@@ -3277,6 +3397,8 @@ void SpatiaLite::fetchWeatherDataQCData(const std::string &sqlStmt,
   }
   catch (...)
   {
+    // Report an interrupted statement as a cancellation
+    checkCancellation(cancellation);
     throw Fmi::Exception::Trace(BCP, "Operation failed");
   }
 }
@@ -41,6 +41,7 @@ namespace Engine
 namespace Observation
 {
 struct SpatiaLiteCacheParameters;
+class DataCoverage;
 class ObservationMemoryCache;
 
 struct QueryMapping;
@@ -439,6 +440,7 @@ class SpatiaLite : public CommonDatabaseFunctions
                               const StationInfo &stationInfo,
                               const std::set<std::string> &stationgroup_codes,
                               const TS::RequestLimits &requestLimits,
+                              const QueryCancellationPtr &cancellation,
                               LocationDataItems &cacheData) override;
   std::string sqlSelectFromWeatherDataQCData(const Settings &settings,
                                              const std::string &params,
@@ -451,6 +453,16 @@ class SpatiaLite : public CommonDatabaseFunctions
   void initExtMemoryCache(const Fmi::DateTime &starttime,
                           const std::unique_ptr<ObservationMemoryCache> &extMemoryCache);
 
+  /**
+   * @brief Add the time spans of all observations in observation_data to the coverage
+   * @param coverage The coverage to be initialized
+   */
+
+  void initDataCoverage(DataCoverage &coverage);
+
+  // Coverage of observation_data used to prune stations and measurands from queries
+  void setDataCoverage(const DataCoverage *coverage) { itsDataCoverage = coverage; }
+
   TS::TimeSeriesVectorPtr getMagnetometerData(
       const Spine::Stations &stations,
       const Settings &settings,
@@ -478,6 +490,8 @@ class SpatiaLite : public CommonDatabaseFunctions
 
   bool itsReadOnly = false;
 
+  const DataCoverage *itsDataCoverage = nullptr;
+
   Fmi::DateTime getLatestTimeFromTable(const std::string &tablename, const std::string &time_field);
   Fmi::DateTime getOldestTimeFromTable(const std::string &tablename, const std::string &time_field);
 
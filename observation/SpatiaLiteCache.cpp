@@ -1,7 +1,9 @@
 #include "SpatiaLiteCache.h"
 #include "FlashMemoryCache.h"
 #include "ObservationMemoryCache.h"
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/split.hpp>
 #include <boost/make_shared.hpp>
 #include <macgyver/StringConversion.h>
 #include <spine/Convenience.h>
@@ -70,6 +72,22 @@ void SpatiaLiteCache::initializeConnectionPool()
       auto end = db->getLatestObservationTime();
       itsTimeIntervalStart = start;
       itsTimeIntervalEnd = end;
+
+      // Scanning the whole table takes a while, hence the coverage is initialized in the
+      // background. Until then nothing is pruned.
+      itsBackgroundTasks.add("ini-coverage",
+                             [this]()
+                             {
+                               try
+                               {
+                                 initDataCoverage();
+                               }
+                               catch (std::exception &err)
+                               {
+                                 logMessage(std::string(": initDataCoverage(): ") + err.what(),
+                                            itsParameters.quiet);
+                               }
+                             });
     }
 
     // WeatherDataQC
@@ -289,6 +307,7 @@ TS::TimeSeriesVectorPtr SpatiaLiteCache::valuesFromCache(Settings &settings)
       else
       {
         checkObsMemoryCacheHit(settings.starttime);
+        db->setDataCoverage(&itsDataCoverage);
         ret = db->CommonDatabaseFunctions::getObservationData(
             stations, settings, *sinfo, itsTimeZones, itsObservationMemoryCache);
       }
@@ -361,6 +380,7 @@ TS::TimeSeriesVectorPtr SpatiaLiteCache::valuesFromCache(
       else
       {
         checkObsMemoryCacheHit(settings.starttime);
+        db->setDataCoverage(&itsDataCoverage);
         ret = db->getObservationData(
             stations, settings, *sinfo, timeSeriesOptions, itsTimeZones, itsObservationMemoryCache);
       }
@@ -525,6 +545,36 @@ bool SpatiaLiteCache::dataAvailableInCache(const Settings &settings) const
   }
 }
 
+Fmi::DateTime SpatiaLiteCache::cachedIntervalStart(const Settings &settings) const
+{
+  try
+  {
+    if (settings.useCommonQueryMethod)
+    {
+      Spine::ReadLock lock(itsTimeIntervalMutex);
+      if (itsTimeIntervalEnd.is_not_a_date_time())
+        return Fmi::DateTime::NOT_A_DATE_TIME;
+      return itsTimeIntervalStart;
+    }
+
+    const auto &s = settings.stationtype;
+
+    if (s == "road" || s == "foreign" || s == "observations_fmi_extaws")
+    {
+      Spine::ReadLock lock(itsWeatherDataQCTimeIntervalMutex);
+      if (itsWeatherDataQCTimeIntervalEnd.is_not_a_date_time())
+        return Fmi::DateTime::NOT_A_DATE_TIME;
+      return itsWeatherDataQCTimeIntervalStart;
+    }
+
+    return Fmi::DateTime::NOT_A_DATE_TIME;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 FlashCounts SpatiaLiteCache::getFlashCount(const Fmi::DateTime &starttime,
                                            const Fmi::DateTime &endtime,
                                            const Spine::TaggedLocationList &locations) const
@@ -1114,6 +1164,9 @@ std::size_t SpatiaLiteCache::fillDataCache(const DataItems &cacheData) const
     if (itsObservationMemoryCache)
       itsObservationMemoryCache->fill(cacheData);
 
+    // The coverage may claim the data before it is in the database, but not vice versa
+    itsDataCoverage.add(cacheData);
+
     auto conn = itsConnectionPool->get();
     auto sz = conn->fillDataCache("observation_data", cacheData, itsDataInsertCache);
 
@@ -1184,6 +1237,7 @@ void SpatiaLiteCache::cleanDataCache(const Fmi::TimeDuration &timetokeep,
     auto conn = itsConnectionPool->get();
     conn->cleanMovingLocationsCache(time1);
     conn->cleanDataCache(time1);
+    itsDataCoverage.clean(time1);
 
     // Update what really remains in the database
     auto start = conn->getOldestObservationTime();
@@ -1362,8 +1416,33 @@ void SpatiaLiteCache::cleanMagnetometerCache(const Fmi::TimeDuration &timetokeep
   }
 }
 
+void SpatiaLiteCache::initDataCoverage()
+{
+  try
+  {
+    logMessage("[Observation Engine] Initializing SpatiaLite observation data coverage...",
+               itsParameters.quiet);
+    itsConnectionPool->get()->initDataCoverage(itsDataCoverage);
+    logMessage("[Observation Engine] SpatiaLite observation data coverage initialized",
+               itsParameters.quiet);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 void SpatiaLiteCache::shutdown()
 {
+  itsBackgroundTasks.stop();
+  try
+  {
+    itsBackgroundTasks.wait();
+  }
+  catch (...)
+  {
+    // We are not interested about possible exceptions when shutting down
+  }
 #if 0
   if (itsConnectionPool)
     itsConnectionPool->shutdown();
@@ -1484,6 +1563,43 @@ Fmi::DateTime SpatiaLiteCache::getLatestDataUpdateTime(const std::string &tablen
       tablename, starttime, producer_ids, measurand_ids);
 }
 
+std::set<int> SpatiaLiteCache::stationsWithObservations(const std::vector<int> &fmisids,
+                                                        const std::string &measurand_ids,
+                                                        const Fmi::DateTime &starttime,
+                                                        const Fmi::DateTime &endtime,
+                                                        const std::string &tablename) const
+{
+  try
+  {
+    if (tablename != OBSERVATION_DATA_TABLE)
+      return {fmisids.begin(), fmisids.end()};
+
+    // The coverage knows nothing about observations older than the cache. Newer observations
+    // are added to the coverage as soon as they are written into the cache, hence a query
+    // extending past the latest cached observation can still be filtered.
+    {
+      Spine::ReadLock lock(itsTimeIntervalMutex);
+      if (itsTimeIntervalStart.is_not_a_date_time() || itsTimeIntervalEnd.is_not_a_date_time() ||
+          starttime < itsTimeIntervalStart)
+        return {fmisids.begin(), fmisids.end()};
+    }
+
+    std::vector<std::string> parts;
+    boost::algorithm::split(parts, measurand_ids, boost::algorithm::is_any_of(","));
+
+    std::vector<int> ids;
+    for (const auto &part : parts)
+      if (!part.empty())
+        ids.push_back(Fmi::stoi(part));
+
+    return itsDataCoverage.stationsWithData(fmisids, ids, starttime, endtime);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Checking stations with observations from cache failed!");
+  }
+}
+
 void SpatiaLiteCache::hit(const std::string &name) const
 {
   Spine::WriteLock lock(itsCacheStatisticsMutex);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "DataCoverage.h"
 #include "EngineParameters.h"
 #include "InsertStatus.h"
 #include "ObservationCache.h"
@@ -7,6 +8,7 @@
 #include "SpatiaLite.h"
 #include "SpatiaLiteCacheParameters.h"
 #include "StationtypeConfig.h"
+#include <macgyver/AsyncTaskGroup.h>
 #include <mutex>
 #include <string>
 
@@ -46,6 +48,7 @@ class SpatiaLiteCache : public ObservationCache
       Settings &settings, const TS::TimeSeriesGeneratorOptions &timeSeriesOptions) override;
 
   bool dataAvailableInCache(const Settings &settings) const override;
+  Fmi::DateTime cachedIntervalStart(const Settings &settings) const override;
   bool flashIntervalIsCached(const Fmi::DateTime &starttime,
                              const Fmi::DateTime &endtime) const override;
   FlashCounts getFlashCount(const Fmi::DateTime &starttime,
@@ -150,6 +153,11 @@ class SpatiaLiteCache : public ObservationCache
   void getMovingStations(Spine::Stations &stations,
                          const Settings &settings,
                          const std::string &wkt) const override;
+  std::set<int> stationsWithObservations(const std::vector<int> &fmisids,
+                                         const std::string &measurand_ids,
+                                         const Fmi::DateTime &starttime,
+                                         const Fmi::DateTime &endtime,
+                                         const std::string &tablename) const override;
 
   using PoolType =
       Fmi::Pool<Fmi::PoolInitType::Sequential, SpatiaLite, std::string, SpatiaLiteCacheParameters>;
@@ -210,6 +218,13 @@ class SpatiaLiteCache : public ObservationCache
   mutable InsertStatus itsTapsiQcInsertCache;
   mutable InsertStatus itsMagnetometerInsertCache;
 
+  // Time spans of the observations in observation_data per station and measurand
+  mutable DataCoverage itsDataCoverage;
+  void initDataCoverage();
+
+  // Initialization tasks run after the connection pool has been created
+  Fmi::AsyncTaskGroup itsBackgroundTasks;
+
   // Memory caches smaller than the spatialite cache itself
   std::unique_ptr<ObservationMemoryCache> itsObservationMemoryCache;
   std::unique_ptr<ObservationMemoryCache> itsExtMemoryCache;
@@ -0,0 +1,176 @@
+#include "StationGeonamesCache.h"
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <macgyver/AnsiEscapeCodes.h>
+#include <macgyver/Exception.h>
+#include <spine/Convenience.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+void copy_geonames_info(const Spine::Station& from, Spine::Station& to)
+{
+  to.country = from.country;
+  to.iso2 = from.iso2;
+  to.geoid = from.geoid;
+  to.requestedLat = from.requestedLat;
+  to.requestedLon = from.requestedLon;
+  to.requestedName = from.requestedName;
+  to.timezone = from.timezone;
+  to.region = from.region;
+  to.elevation = from.elevation;
+  to.stationDirection = from.stationDirection;
+}
+}  // anonymous namespace
+
+StationGeonamesCache::StationGeonamesCache(std::string filename, std::size_t maxAge)
+    : itsFilename(std::move(filename)), itsMaxAge(maxAge)
+{
+}
+
+bool StationGeonamesCache::get(Spine::Station& station, const std::string& language)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    load();
+
+    auto pos = itsEntries.find(Key(station, language));
+    if (pos == itsEntries.end())
+      return false;
+
+    const auto& entry = pos->second;
+    if (itsMaxAge > 0 && std::time(nullptr) - entry.created > static_cast<std::time_t>(itsMaxAge))
+      return false;
+
+    copy_geonames_info(entry.station, station);
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void StationGeonamesCache::set(const Spine::Station& station, const std::string& language)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    load();
+
+    Entry entry;
+    entry.station.fmisid = station.fmisid;
+    entry.station.longitude = station.longitude;
+    entry.station.latitude = station.latitude;
+    copy_geonames_info(station, entry.station);
+    entry.created = std::time(nullptr);
+
+    itsEntries[Key(station, language)] = entry;
+    itsModified = true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void StationGeonamesCache::retain(const Spine::Stations& stations)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    load();
+
+    std::set<std::tuple<int, double, double>> locations;
+    for (const auto& station : stations)
+      locations.emplace(station.fmisid, station.longitude, station.latitude);
+
+    for (auto pos = itsEntries.begin(); pos != itsEntries.end();)
+    {
+      const auto& key = pos->first;
+      if (locations.count(std::make_tuple(key.fmisid, key.longitude, key.latitude)) > 0)
+        ++pos;
+      else
+      {
+        pos = itsEntries.erase(pos);
+        itsModified = true;
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void StationGeonamesCache::load()
+{
+  if (itsLoaded)
+    return;
+  itsLoaded = true;
+
+  if (!std::filesystem::exists(itsFilename))
+    return;
+
+  // The entries can always be looked up again, hence a broken file is not an error
+  try
+  {
+    std::ifstream file(itsFilename, std::ios::binary);
+    boost::archive::binary_iarchive archive(file);
+    archive >> itsEntries;
+  }
+  catch (...)
+  {
+    itsEntries.clear();
+    std::cout << Spine::log_time_str() << ANSI_FG_RED
+              << " Ignoring unreadable station Geonames cache " << itsFilename << ANSI_FG_DEFAULT
+              << '\n';
+  }
+}
+
+void StationGeonamesCache::save()
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    if (!itsModified)
+      return;
+
+    auto directory = std::filesystem::path(itsFilename).parent_path();
+    if (!directory.empty() && !std::filesystem::is_directory(directory))
+      std::filesystem::create_directories(directory);
+
+    // Write via a temporary file just in case the server aborts
+    const std::string tmpfile = itsFilename + ".tmp";
+    {
+      std::ofstream file(tmpfile, std::ios::binary);
+      if (!file)
+        throw Fmi::Exception(BCP, "Failed to open " + tmpfile + " for writing");
+      boost::archive::binary_oarchive archive(file);
+      archive << itsEntries;
+    }
+    std::filesystem::rename(tmpfile, itsFilename);
+    itsModified = false;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Saving station Geonames information failed!")
+        .addParameter("filename", itsFilename);
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
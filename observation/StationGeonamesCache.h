@@ -0,0 +1,99 @@
+#pragma once
+
+#include <spine/Station.h>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Geonames information of stations by fmisid, location and language. A station may have
+// several rows with different locations, each of which has its own entry. The information is
+// saved to disk so that unchanged stations need not be looked up again when the stations are
+// reloaded or the server is restarted. The information is valid for as long as the station
+// does not move and the entry is not older than the maximum age.
+
+class StationGeonamesCache
+{
+ public:
+  // Zero maximum age means the entries never expire
+  StationGeonamesCache(std::string filename, std::size_t maxAge);
+
+  // Copy the cached information to the station, returns false if there is no valid entry
+  bool get(Spine::Station& station, const std::string& language);
+
+  void set(const Spine::Station& station, const std::string& language);
+
+  // Remove the entries of stations and locations which no longer exist
+  void retain(const Spine::Stations& stations);
+
+  // Write the entries to disk if they have changed
+  void save();
+
+ private:
+  struct Key
+  {
+    int fmisid = 0;
+    double longitude = 0;
+    double latitude = 0;
+    std::string language;
+
+    Key() = default;
+    Key(const Spine::Station& station, std::string lang)
+        : fmisid(station.fmisid),
+          longitude(station.longitude),
+          latitude(station.latitude),
+          language(std::move(lang))
+    {
+    }
+
+    bool operator<(const Key& other) const
+    {
+      return std::tie(fmisid, longitude, latitude, language) <
+             std::tie(other.fmisid, other.longitude, other.latitude, other.language);
+    }
+
+    template <class Archive>
+    void serialize(Archive& archive, const unsigned int /* version */)
+    {
+      archive& fmisid;
+      archive& longitude;
+      archive& latitude;
+      archive& language;
+    }
+  };
+
+  struct Entry
+  {
+    Spine::Station station;
+    std::time_t created = 0;
+
+    template <class Archive>
+    void serialize(Archive& archive, const unsigned int /* version */)
+    {
+      archive& station;
+      archive& created;
+    }
+  };
+
+  void load();
+
+  const std::string itsFilename;
+  const std::size_t itsMaxAge;
+
+  std::mutex itsMutex;
+  bool itsLoaded = false;
+  bool itsModified = false;
+  std::map<Key, Entry> itsEntries;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -7,15 +7,30 @@
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/xml_oarchive.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iostreams/stream.hpp>
 #include <boost/serialization/map.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/vector.hpp>
 #include <fmt/format.h>
 #include <gis/OGR.h>
+#include <macgyver/Cache.h>
 #include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
 #include <macgyver/StringConversion.h>
+#include <ogr_geometry.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
 
 namespace SmartMet
 {
@@ -57,21 +72,383 @@ bool timeok(const Spine::Station& station,
   return !(endtime < station.station_start || starttime > station.station_end);
 }
 
+namespace
+{
+// Dimensions of the bounding box search grid
+const std::size_t grid_columns = 360;
+const std::size_t grid_rows = 180;
+const std::size_t grid_cells = grid_columns * grid_rows;
+
+std::size_t grid_index(double value, double origin, std::size_t size)
+{
+  const double pos = std::floor(value - origin);
+  if (!(pos > 0))  // also NaN
+    return 0;
+  if (pos >= static_cast<double>(size - 1))
+    return size - 1;
+  return static_cast<std::size_t>(pos);
+}
+
+std::size_t grid_column(double longitude)
+{
+  return grid_index(longitude, -180, grid_columns);
+}
+
+std::size_t grid_row(double latitude)
+{
+  return grid_index(latitude, -90, grid_rows);
+}
+
+// Three consecutive characters of a case folded name packed into an index key
+unsigned int name_trigram(const std::string& name, std::size_t pos)
+{
+  return (static_cast<unsigned int>(static_cast<unsigned char>(name[pos])) << 16) |
+         (static_cast<unsigned int>(static_cast<unsigned char>(name[pos + 1])) << 8) |
+         static_cast<unsigned int>(static_cast<unsigned char>(name[pos + 2]));
+}
+
+// Bit shared by the groups which do not fit into the group masks
+const unsigned int shared_group_bit = StationGroupBits().size() - 1;
+
+std::uint64_t next_layout()
+{
+  static std::atomic<std::uint64_t> layout{0};
+  return ++layout;
+}
+
+void erase_station(std::map<std::string, std::set<StationID>>& index,
+                   const std::string& key,
+                   StationID id)
+{
+  auto pos = index.find(key);
+  if (pos == index.end())
+    return;
+  pos->second.erase(id);
+  if (pos->second.empty())
+    index.erase(pos);
+}
+
 // ----------------------------------------------------------------------
 /*!
- * \brief Test if the station belongs to any of the groups
+ * \brief Parsed WKT area used in station searches
+ *
+ * Prepared geometries must not be used by several threads at the same
+ * time, hence idle prepared geometries are kept in a pool from which
+ * each search takes one.
  */
 // ----------------------------------------------------------------------
 
-bool groupok(const Spine::Station& station, const std::set<std::string>& groups)
+class StationArea
 {
-  // All groups allowed?
-  if (groups.empty())
-    return true;
+ public:
+  explicit StationArea(std::string wkt)
+      : itsWkt(std::move(wkt)),
+        itsGeometry(Fmi::OGR::createFromWkt(itsWkt, 4326), &OGRGeometryFactory::destroyGeometry)
+  {
+    itsGeometry->getEnvelope(&itsEnvelope);
+  }
+
+  const std::string& wkt() const { return itsWkt; }
+  const OGREnvelope& envelope() const { return itsEnvelope; }
+
+  // Run the function with a contains(lon, lat) predicate using a prepared geometry
+  // reserved for this search
+  template <typename Function>
+  void search(Function function)
+  {
+    OGRPreparedGeometryUniquePtr prepared;
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      if (!itsPrepared.empty())
+      {
+        prepared = std::move(itsPrepared.back());
+        itsPrepared.pop_back();
+      }
+    }
+    if (!prepared && OGRHasPreparedGeometrySupport())
+      prepared = OGRCreatePreparedGeometry(itsGeometry.get());
+
+    auto contains = [&](double lon, double lat)
+    {
+      OGRPoint point(lon, lat);
+      if (prepared)
+        return OGRPreparedGeometryContains(prepared.get(), &point) != 0;
+      return itsGeometry->Contains(&point) != 0;
+    };
+
+    function(contains);
+
+    if (prepared)
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      itsPrepared.push_back(std::move(prepared));
+    }
+  }
+
+ private:
+  std::string itsWkt;
+  std::shared_ptr<OGRGeometry> itsGeometry;
+  OGREnvelope itsEnvelope;
+
+  std::mutex itsMutex;
+  std::vector<OGRPreparedGeometryUniquePtr> itsPrepared;
+};
+
+using StationAreaPtr = std::shared_ptr<StationArea>;
+
+// Parsed areas by the hash of the WKT. The areas do not depend on the station
+// information, hence the cache is shared by all StationInfo instances.
+
+class StationAreaCache
+{
+ public:
+  StationAreaCache() { itsCache.resize(500); }
+
+  StationAreaPtr get(const std::string& wkt)
+  {
+    const auto key = Fmi::hash_value(wkt);
+    auto cached = itsCache.find(key);
+    if (cached && (*cached)->wkt() == wkt)
+      return *cached;
+
+    auto area = std::make_shared<StationArea>(wkt);
+    itsCache.insert(key, area);
+    return area;
+  }
+
+ private:
+  Fmi::Cache::Cache<std::size_t, StationAreaPtr> itsCache;
+};
+
+StationAreaCache& station_area_cache()
+{
+  static StationAreaCache cache;
+  return cache;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Binary station snapshots
+ *
+ * Layout in native byte order, all sections aligned to 8 bytes:
+ *
+ *   char[8]  magic "SMSTSNAP"
+ *   uint32   version
+ *   uint32   byte order marker 0x01020304
+ *   uint64   number of sections
+ *   {uint32 type, uint32 reserved, uint64 offset, uint64 size} per section
+ *   section data
+ *
+ * The station table is a boost binary archive of the stations, since the
+ * station fields are defined by Spine. The indexes and the search grid are
+ * stored in their in-memory order, hence they are copied from the mapped file
+ * without sorting. The near tree, the station groups and the name index have
+ * no flat representation and are rebuilt.
+ */
+// ----------------------------------------------------------------------
+
+const char snapshot_magic[8] = {'S', 'M', 'S', 'T', 'S', 'N', 'A', 'P'};
+const std::uint32_t snapshot_version = 1;
+const std::uint32_t snapshot_byte_order = 0x01020304;
+
+enum class SnapshotSection : std::uint32_t
+{
+  Stations = 1,        // boost binary archive
+  FmisidIndex = 2,     // {uint32 fmisid, uint32 id} sorted
+  WmoIndex = 3,        // {uint32 wmo, uint32 id} sorted
+  LpnnIndex = 4,       // {uint32 lpnn, uint32 id} sorted
+  RwsidIndex = 5,      // {uint32 rwsid, uint32 id} sorted
+  WsiIndex = 6,        // {uint32 length, uint32 count, name padded to 4, uint32 ids[count]}
+  GroupMembers = 7,    // as WsiIndex
+  Grid = 8,            // uint32 columns, uint32 rows, uint32 offsets[cells+1], uint32 ids
+  RoadFmisids = 9,     // int32 fmisids
+  ForeignFmisids = 10  // int32 fmisids
+};
+
+template <typename T>
+void append(std::string& out, T value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void pad(std::string& out, std::size_t alignment)
+{
+  out.append((alignment - out.size() % alignment) % alignment, '\0');
+}
+
+std::string write_index(const StationIndex& index)
+{
+  std::string out;
+  for (std::size_t i = 0; i < index.size(); ++i)
+    for (const auto id : index.stations(i))
+    {
+      append<std::uint32_t>(out, index.key(i));
+      append<std::uint32_t>(out, id);
+    }
+  return out;
+}
+
+std::string write_index(const NamedStationIndex& index)
+{
+  std::string out;
+  for (std::size_t i = 0; i < index.size(); ++i)
+  {
+    const auto ids = index.stations(i);
+    append<std::uint32_t>(out, index.key(i).size());
+    append<std::uint32_t>(out, ids.size());
+    out += index.key(i);
+    pad(out, 4);
+    for (const auto id : ids)
+      append<std::uint32_t>(out, id);
+  }
+  return out;
+}
+
+std::string write_index(const std::map<std::string, std::set<StationID>>& index)
+{
+  std::string out;
+  for (const auto& item : index)
+  {
+    append<std::uint32_t>(out, item.first.size());
+    append<std::uint32_t>(out, item.second.size());
+    out += item.first;
+    pad(out, 4);
+    for (const auto id : item.second)
+      append<std::uint32_t>(out, id);
+  }
+  return out;
+}
+
+std::string write_fmisids(const std::set<int>& fmisids)
+{
+  std::string out;
+  for (const auto fmisid : fmisids)
+    append<std::int32_t>(out, fmisid);
+  return out;
+}
+
+// Bounds checked reads from a mapped section
+class SnapshotReader
+{
+ public:
+  SnapshotReader(const char* data, std::size_t size) : itsData(data), itsSize(size) {}
+
+  bool done() const { return itsPos >= itsSize; }
+  std::size_t remaining() const { return itsSize - itsPos; }
+
+  template <typename T>
+  T read()
+  {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string readString(std::size_t length)
+  {
+    std::string value(take(length), length);
+    itsPos = std::min(itsSize, itsPos + (4 - length % 4) % 4);
+    return value;
+  }
+
+  const char* take(std::size_t length)
+  {
+    if (length > remaining())
+      throw Fmi::Exception(BCP, "Station snapshot is truncated");
+    const char* ptr = itsData + itsPos;
+    itsPos += length;
+    return ptr;
+  }
+
+ private:
+  const char* itsData;
+  std::size_t itsSize;
+  std::size_t itsPos = 0;
+};
+
+StationID read_station_id(SnapshotReader& reader, std::size_t nstations)
+{
+  const auto id = reader.read<std::uint32_t>();
+  if (id >= nstations)
+    throw Fmi::Exception(BCP, "Station snapshot contains an invalid station index");
+  return id;
+}
+
+// The pairs are sorted, hence the flat arrays are filled by appending
+void read_index(SnapshotReader& reader, std::size_t nstations, StationIndex& index)
+{
+  std::vector<unsigned int> keys;
+  std::vector<StationID> offsets;
+  std::vector<StationID> ids;
+  ids.reserve(reader.remaining() / 8);
+  while (!reader.done())
+  {
+    const auto key = reader.read<std::uint32_t>();
+    if (keys.empty() || keys.back() != key)
+    {
+      keys.push_back(key);
+      offsets.push_back(ids.size());
+    }
+    ids.push_back(read_station_id(reader, nstations));
+  }
+  offsets.push_back(ids.size());
+
+  if (!index.assignSorted(std::move(keys), std::move(offsets), std::move(ids)))
+    throw Fmi::Exception(BCP, "Station snapshot contains an unsorted index");
+}
+
+void read_index(SnapshotReader& reader, std::size_t nstations, NamedStationIndex& index)
+{
+  std::vector<std::string> keys;
+  std::vector<StationID> offsets;
+  std::vector<StationID> ids;
+  while (!reader.done())
+  {
+    const auto length = reader.read<std::uint32_t>();
+    const auto count = reader.read<std::uint32_t>();
+    keys.push_back(reader.readString(length));
+    offsets.push_back(ids.size());
+    for (std::uint32_t i = 0; i < count; i++)
+      ids.push_back(read_station_id(reader, nstations));
+  }
+  offsets.push_back(ids.size());
 
-  return (groups.find(station.type) != groups.end());
+  if (!index.assignSorted(std::move(keys), std::move(offsets), std::move(ids)))
+    throw Fmi::Exception(BCP, "Station snapshot contains an unsorted index");
 }
 
+// Pairs are sorted, hence the maps and sets are filled by appending
+void read_index(SnapshotReader& reader,
+                std::size_t nstations,
+                std::map<std::string, std::set<StationID>>& index)
+{
+  while (!reader.done())
+  {
+    const auto length = reader.read<std::uint32_t>();
+    const auto count = reader.read<std::uint32_t>();
+    auto& ids =
+        index.emplace_hint(index.end(), reader.readString(length), std::set<StationID>())->second;
+    for (std::uint32_t i = 0; i < count; i++)
+      ids.insert(ids.end(), read_station_id(reader, nstations));
+  }
+}
+
+void read_fmisids(SnapshotReader& reader, std::set<int>& fmisids)
+{
+  while (!reader.done())
+    fmisids.insert(fmisids.end(), reader.read<std::int32_t>());
+}
+
+bool is_snapshot(const std::string& filename)
+{
+  char magic[sizeof(snapshot_magic)];
+  std::ifstream file(filename, std::ios::binary);
+  return (file.read(magic, sizeof(magic)) &&
+          std::memcmp(magic, snapshot_magic, sizeof(snapshot_magic)) == 0);
+}
+
+}  // anonymous namespace
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Create the directory for the serialized stations
@@ -117,7 +494,7 @@ void StationInfo::serialize(const std::string& filename) const
 
     std::string tmpfile = filename + ".tmp";
 
-    std::ofstream file(tmpfile);
+    std::ofstream file(tmpfile, std::ios::binary);
     if (!file)
       throw Fmi::Exception(BCP, "Failed to open " + tmpfile + " for writing");
 
@@ -132,10 +509,11 @@ void StationInfo::serialize(const std::string& filename) const
       archive& BOOST_SERIALIZATION_NVP(stations);
     }
     else
-    {
-      boost::archive::binary_oarchive archive(file);
-      archive& BOOST_SERIALIZATION_NVP(stations);
-    }
+      writeSnapshot(file);
+
+    file.close();
+    if (file.fail())
+      throw Fmi::Exception(BCP, "Failed to write " + tmpfile);
 
     // Rename to final filename
     try
@@ -172,6 +550,21 @@ StationInfo::StationInfo(const std::string& filename)
 
 void StationInfo::unserialize(const std::string& filename)
 {
+  if (!boost::algorithm::iends_with(filename, ".txt") &&
+      !boost::algorithm::iends_with(filename, ".xml"))
+  {
+    if (readSnapshot(filename))
+      return;
+
+    // A snapshot written by an incompatible version is ignored, the stations will be
+    // reloaded from the database
+    if (is_snapshot(filename))
+    {
+      update();
+      return;
+    }
+  }
+
   std::ifstream file(filename);
 
   if (boost::algorithm::iends_with(filename, ".txt"))
@@ -271,6 +664,8 @@ Spine::Stations StationInfo::findNearestStations(const NearestCandidateList& can
 
   std::set<int> used_fmisids;
 
+  const auto mask = groupMask(groups);
+
   for (const auto& candidate : candidates)
   {
     StationID id = candidate.second;
@@ -279,7 +674,7 @@ Spine::Stations StationInfo::findNearestStations(const NearestCandidateList& can
     if (!timeok(station, starttime, endtime))
       continue;
 
-    if (!groupok(station, groups))
+    if (!groupOk(id, mask))
       continue;
 
     double distance = StationNearTreeLatLon::SurfaceLength(candidate.first);
@@ -349,14 +744,10 @@ Spine::Stations findStations(const Spine::Stations& stations, const IDS& ids, co
 
   for (const auto& id : ids)
   {
-    const auto pos = index.find(id);
-    if (pos != index.end())
+    for (const auto& sid : index.find(id))
     {
-      for (const auto& sid : pos->second)
-      {
-        const auto& station = stations.at(sid);
-        result.push_back(station);
-      }
+      const auto& station = stations.at(sid);
+      result.push_back(station);
     }
   }
   return result;
@@ -368,9 +759,9 @@ Spine::Stations findStations(const Spine::Stations& stations, const IDS& ids, co
  */
 // ----------------------------------------------------------------------
 
-template <typename IDS, typename INDEX>
+template <typename IDS, typename INDEX, typename GROUPOK>
 Spine::Stations findStations(const Spine::Stations& stations,
-                             const std::set<std::string>& groups,
+                             const GROUPOK& groupok,
                              const IDS& ids,
                              const INDEX& index,
                              const Fmi::DateTime& starttime,
@@ -380,23 +771,19 @@ Spine::Stations findStations(const Spine::Stations& stations,
 
   for (const auto& id : ids)
   {
-    const auto pos = index.find(id);
-    if (pos != index.end())
+    for (const auto& sid : index.find(id))
     {
-      for (const auto& sid : pos->second)
-      {
-        const auto& station = stations.at(sid);
+      const auto& station = stations.at(sid);
 
-        // Validate timerange
-        if (!timeok(station, starttime, endtime))
-          continue;
+      // Validate timerange
+      if (!timeok(station, starttime, endtime))
+        continue;
 
-        // Validate group
-        if (!groupok(station, groups))
-          continue;
+      // Validate group
+      if (!groupok(sid))
+        continue;
 
-        result.push_back(station);
-      }
+      result.push_back(station);
     }
   }
   return result;
@@ -507,7 +894,9 @@ Spine::Stations StationInfo::findFmisidStations(const std::vector<int>& fmisids,
                                                 const Fmi::DateTime& starttime,
                                                 const Fmi::DateTime& endtime) const
 {
-  return findStations(stations, groups, fmisids, fmisidstations, starttime, endtime);
+  const auto mask = groupMask(groups);
+  auto groupok = [&](StationID id) { return groupOk(id, mask); };
+  return findStations(stations, groupok, fmisids, fmisidstations, starttime, endtime);
 }
 
 // ----------------------------------------------------------------------
@@ -532,7 +921,9 @@ Spine::Stations StationInfo::findWmoStations(const std::vector<int>& wmos,
                                              const Fmi::DateTime& starttime,
                                              const Fmi::DateTime& endtime) const
 {
-  return findStations(stations, groups, wmos, wmostations, starttime, endtime);
+  const auto mask = groupMask(groups);
+  auto groupok = [&](StationID id) { return groupOk(id, mask); };
+  return findStations(stations, groupok, wmos, wmostations, starttime, endtime);
 }
 
 // ----------------------------------------------------------------------
@@ -557,7 +948,9 @@ Spine::Stations StationInfo::findLpnnStations(const std::vector<int>& lpnns,
                                               const Fmi::DateTime& starttime,
                                               const Fmi::DateTime& endtime) const
 {
-  return findStations(stations, groups, lpnns, lpnnstations, starttime, endtime);
+  const auto mask = groupMask(groups);
+  auto groupok = [&](StationID id) { return groupOk(id, mask); };
+  return findStations(stations, groupok, lpnns, lpnnstations, starttime, endtime);
 }
 
 // ----------------------------------------------------------------------
@@ -582,7 +975,9 @@ Spine::Stations StationInfo::findRwsidStations(const std::vector<int>& rwsids,
                                                const Fmi::DateTime& starttime,
                                                const Fmi::DateTime& endtime) const
 {
-  return findStations(stations, groups, rwsids, rwsidstations, starttime, endtime);
+  const auto mask = groupMask(groups);
+  auto groupok = [&](StationID id) { return groupOk(id, mask); };
+  return findStations(stations, groupok, rwsids, rwsidstations, starttime, endtime);
 }
 
 // ----------------------------------------------------------------------
@@ -607,7 +1002,9 @@ Spine::Stations StationInfo::findWsiStations(const std::vector<std::string>& wsi
                                              const Fmi::DateTime& starttime,
                                              const Fmi::DateTime& endtime) const
 {
-  return findStations(stations, groups, wsis, wsistations, starttime, endtime);
+  const auto mask = groupMask(groups);
+  auto groupok = [&](StationID id) { return groupOk(id, mask); };
+  return findStations(stations, groupok, wsis, wsistations, starttime, endtime);
 }
 
 // ----------------------------------------------------------------------
@@ -660,28 +1057,28 @@ Spine::Stations StationInfo::findStationsInsideArea(const std::set<std::string>&
   {
     Spine::Stations ret;
 
-    // Get stations belonging to the requested groups and period
-    Spine::Stations groupStations = findStationsInGroup(groups, starttime, endtime);
-    // Create area geometry from wkt-string
-    std::shared_ptr<OGRGeometry> areaGeometry(Fmi::OGR::createFromWkt(wkt, 4326),
-                                              &OGRGeometryFactory::destroyGeometry);
-    // Create spatial refernce to be used below
-    OGRSpatialReference srs;
-    srs.importFromEPSGA(4326);
+    if (groups.empty())
+      return ret;
 
-    // Iterate stations
-    for (const auto& station : groupStations)
-    {
-      // Create Point geometry from sation coordinates
-      OGRPoint stationLocation(station.longitude, station.latitude);
-      stationLocation.assignSpatialReference(&srs);
+    auto area = station_area_cache().get(wkt);
+    const auto mask = groupMask(groups);
+
+    // Stations inside the envelope of the area which belong to the requested groups and period
+    const auto& envelope = area->envelope();
+    auto ids = searchStations(envelope.MinX, envelope.MinY, envelope.MaxX, envelope.MaxY);
+
+    area->search(
+        [&](const auto& contains)
+        {
+          for (const auto id : ids)
+          {
+            const auto& station = stations[id];
+            if (groupOk(id, mask) && timeok(station, starttime, endtime) &&
+                contains(station.longitude, station.latitude))
+              ret.push_back(station);
+          }
+        });
 
-      // If station is inside area accept it
-      if (areaGeometry->Contains(&stationLocation))
-      {
-        ret.push_back(station);
-      }
-    }
     // Sort in ascending fmisid order
     std::sort(ret.begin(), ret.end(), sort_stations_function);
 
@@ -703,7 +1100,9 @@ const Spine::Station& StationInfo::getStation(unsigned int fmisid,
                                               const std::set<std::string>& groups,
                                               const Fmi::DateTime& t) const
 {
-  const auto& ids = fmisidstations.at(fmisid);
+  const auto ids = fmisidstations.find(fmisid);
+  if (ids.empty())
+    throw Fmi::Exception(BCP, "Unknown fmisid " + Fmi::to_string(fmisid));
 #if 0  
   bool debug = (fmisid = 101004);
   if (debug)
@@ -722,10 +1121,11 @@ const Spine::Station& StationInfo::getStation(unsigned int fmisid,
   }
 #endif
 
+  const auto mask = groupMask(groups);
   for (const auto id : ids)
   {
     const auto& station = stations.at(id);
-    if (timeok(station, t) && groupok(station, groups))
+    if (timeok(station, t) && groupOk(id, mask))
       return station;
   }
 
@@ -751,69 +1151,142 @@ const Spine::Station& StationInfo::getStation(unsigned int fmisid,
 // ----------------------------------------------------------------------
 
 bool StationInfo::belongsToGroup(unsigned int fmisid, const std::set<std::string>& groups) const
+{
+  return belongsToGroup(fmisid, groupMask(groups));
+}
+
+bool StationInfo::belongsToGroup(unsigned int fmisid, const StationGroupMask& mask) const
 {
   // Check if the station is known
-  const auto pos = fmisidstations.find(fmisid);
-  if (pos == fmisidstations.end())
+  const auto pos = fmisidgroups.find(fmisid);
+  if (pos == fmisidgroups.end())
     return false;
 
   // Empty group setting means any group will do
-  if (groups.empty())
+  if (mask.all)
     return true;
 
   // Require at least one group match
-  const auto& ids = pos->second;
-  for (const auto id : ids)
-  {
-    const auto& station = stations.at(id);
-    if (groups.find(station.type) != groups.end())
+  const auto common = pos->second & mask.bits;
+  if (common.none())
+    return false;
+  if (!common.test(shared_group_bit) || common.count() > 1)
+    return true;
+
+  // Only the shared bit matches, compare the group names
+  for (const auto id : fmisidstations.find(fmisid))
+    if (groupOk(id, mask))
       return true;
-  }
 
   return false;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Translate station groups into a mask
+ */
+// ----------------------------------------------------------------------
+
+StationGroupMask StationInfo::groupMask(const std::set<std::string>& groups) const
+{
+  StationGroupMask mask;
+  mask.all = groups.empty();
+
+  // Unknown groups match no stations
+  for (const auto& group : groups)
+  {
+    const auto pos = groupbits.find(group);
+    if (pos == groupbits.end())
+      continue;
+    mask.bits.set(pos->second);
+    if (pos->second == shared_group_bit)
+      mask.shared.insert(group);
+  }
+
+  return mask;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test if the station belongs to any of the groups
+ */
+// ----------------------------------------------------------------------
+
+bool StationInfo::groupOk(StationID id, const StationGroupMask& mask) const
+{
+  // All groups allowed?
+  if (mask.all)
+    return true;
+
+  const auto bit = stationgroupbit[id];
+  if (!mask.bits.test(bit))
+    return false;
+
+  return (bit != shared_group_bit || mask.shared.find(stations[id].type) != mask.shared.end());
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Search for stations inside the given bounding box
+ *
+ * If maxx < minx the box spans the 180th meridian. The indexes are
+ * returned in ascending order.
  */
 // ----------------------------------------------------------------------
 
-std::vector<StationID> searchStations(
-    const Spine::Stations& stations, double minx, double miny, double maxx, double maxy)
+std::vector<StationID> StationInfo::searchStations(double minx,
+                                                   double miny,
+                                                   double maxx,
+                                                   double maxy) const
 {
   std::vector<StationID> result;
 
-  if (maxx > minx)
+  // Collect the stations of the longitude range x1...x2 from the grid cells
+  // overlapping the box, or from all stations if the grid has not been built
+
+  auto search = [&](double x1, double x2)
   {
-    // Normal bounding box
-    for (StationID id = 0; id < stations.size(); ++id)
+    auto add = [&](StationID id)
     {
-      double lon = stations[id].longitude;
-      if (lon >= minx && lon <= maxx)
+      const double lon = stations[id].longitude;
+      const double lat = stations[id].latitude;
+      if (lon >= x1 && lon <= x2 && lat >= miny && lat <= maxy)
+        result.push_back(id);
+    };
+
+    if (boxgrid.offsets.empty())
+    {
+      for (StationID id = 0; id < stations.size(); ++id)
+        add(id);
+      return;
+    }
+
+    for (std::size_t row = grid_row(miny); row <= grid_row(maxy); ++row)
+      for (std::size_t col = grid_column(x1); col <= grid_column(x2); ++col)
       {
-        double lat = stations[id].latitude;
-        if (lat >= miny && lat <= maxy)
-          result.push_back(id);
+        const auto cell = row * grid_columns + col;
+        for (auto i = boxgrid.offsets[cell]; i < boxgrid.offsets[cell + 1]; ++i)
+          add(boxgrid.ids[i]);
       }
-    }
-  }
+  };
 
+  if (miny > maxy)
+    return result;
+
+  if (maxx > minx)
+    search(minx, maxx);  // Normal bounding box
   else
   {
     // Bounding box spans the 180th meridian
-    for (StationID id = 0; id < stations.size(); ++id)
-    {
-      double lon = stations[id].longitude;
-      if (lon <= minx || lon >= maxx)
-      {
-        double lat = stations[id].latitude;
-        if (lat >= miny && lat <= maxy)
-          result.push_back(id);
-      }
-    }
+    search(minx, 180);
+    search(-180, maxx);
   }
 
+  // Cells are visited row by row, and the halves of a box spanning the 180th meridian
+  // overlap if minx == maxx
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+
   return result;
 }
 
@@ -831,7 +1304,8 @@ Spine::Stations StationInfo::findStationsInsideBox(double minx,
                                                    const Fmi::DateTime& starttime,
                                                    const Fmi::DateTime& endtime) const
 {
-  auto ids = searchStations(stations, minx, miny, maxx, maxy);
+  auto ids = searchStations(minx, miny, maxx, maxy);
+  const auto mask = groupMask(groups);
 
   Spine::Stations result;
 
@@ -841,7 +1315,7 @@ Spine::Stations StationInfo::findStationsInsideBox(double minx,
 
     if (timeok(station, starttime, endtime))
     {
-      if (groupok(station, groups))
+      if (groupOk(id, mask))
         result.push_back(station);
     }
   }
@@ -849,6 +1323,188 @@ Spine::Stations StationInfo::findStationsInsideBox(double minx,
   return result;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the stations and the search indexes as a binary snapshot
+ */
+// ----------------------------------------------------------------------
+
+void StationInfo::writeSnapshot(std::ostream& out) const
+{
+  try
+  {
+    std::vector<std::pair<SnapshotSection, std::string>> sections;
+
+    {
+      std::ostringstream table;
+      boost::archive::binary_oarchive archive(table);
+      archive& BOOST_SERIALIZATION_NVP(stations);
+      sections.emplace_back(SnapshotSection::Stations, table.str());
+    }
+
+    sections.emplace_back(SnapshotSection::FmisidIndex, write_index(fmisidstations));
+    sections.emplace_back(SnapshotSection::WmoIndex, write_index(wmostations));
+    sections.emplace_back(SnapshotSection::LpnnIndex, write_index(lpnnstations));
+    sections.emplace_back(SnapshotSection::RwsidIndex, write_index(rwsidstations));
+    sections.emplace_back(SnapshotSection::WsiIndex, write_index(wsistations));
+    sections.emplace_back(SnapshotSection::GroupMembers, write_index(members));
+
+    std::string grid;
+    append<std::uint32_t>(grid, grid_columns);
+    append<std::uint32_t>(grid, grid_rows);
+    for (const auto offset : boxgrid.offsets)
+      append<std::uint32_t>(grid, offset);
+    for (const auto id : boxgrid.ids)
+      append<std::uint32_t>(grid, id);
+    sections.emplace_back(SnapshotSection::Grid, grid);
+
+    sections.emplace_back(SnapshotSection::RoadFmisids, write_fmisids(roadfmisids));
+    sections.emplace_back(SnapshotSection::ForeignFmisids, write_fmisids(foreignfmisids));
+
+    // Header and the section table
+
+    std::string header(snapshot_magic, sizeof(snapshot_magic));
+    append<std::uint32_t>(header, snapshot_version);
+    append<std::uint32_t>(header, snapshot_byte_order);
+    append<std::uint64_t>(header, sections.size());
+
+    std::uint64_t offset = header.size() + sections.size() * 24;
+    for (auto& section : sections)
+    {
+      append<std::uint32_t>(header, static_cast<std::uint32_t>(section.first));
+      append<std::uint32_t>(header, 0);
+      append<std::uint64_t>(header, offset);
+      append<std::uint64_t>(header, section.second.size());
+      pad(section.second, 8);
+      offset += section.second.size();
+    }
+
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    for (const auto& section : sections)
+      out.write(section.second.data(), static_cast<std::streamsize>(section.second.size()));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Writing station snapshot failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read a binary snapshot
+ *
+ * Returns false if the file is not a snapshot, or if it was written with a
+ * different version or byte order. Indexes missing from the snapshot or built
+ * with different parameters are rebuilt.
+ */
+// ----------------------------------------------------------------------
+
+bool StationInfo::readSnapshot(const std::string& filename)
+{
+  try
+  {
+    boost::iostreams::mapped_file_source file(filename);
+    SnapshotReader reader(file.data(), file.size());
+
+    if (file.size() < sizeof(snapshot_magic) ||
+        std::memcmp(file.data(), snapshot_magic, sizeof(snapshot_magic)) != 0)
+      return false;
+    reader.take(sizeof(snapshot_magic));
+
+    const auto version = reader.read<std::uint32_t>();
+    const auto byte_order = reader.read<std::uint32_t>();
+    if (version != snapshot_version || byte_order != snapshot_byte_order)
+      return false;
+
+    // Locate the sections
+
+    std::map<SnapshotSection, SnapshotReader> sections;
+    const auto nsections = reader.read<std::uint64_t>();
+    for (std::uint64_t i = 0; i < nsections; i++)
+    {
+      const auto type = static_cast<SnapshotSection>(reader.read<std::uint32_t>());
+      reader.read<std::uint32_t>();
+      const auto offset = reader.read<std::uint64_t>();
+      const auto size = reader.read<std::uint64_t>();
+      if (offset > file.size() || size > file.size() - offset)
+        throw Fmi::Exception(BCP, "Station snapshot is truncated");
+      sections.emplace(type, SnapshotReader(file.data() + offset, size));
+    }
+
+    auto table = sections.find(SnapshotSection::Stations);
+    if (table == sections.end())
+      throw Fmi::Exception(BCP, "Station snapshot contains no stations");
+
+    {
+      const auto size = table->second.remaining();
+      boost::iostreams::stream<boost::iostreams::array_source> in(table->second.take(size), size);
+      boost::archive::binary_iarchive archive(in);
+      archive& BOOST_SERIALIZATION_NVP(stations);
+    }
+
+    // Use the prebuilt indexes. Like update(), this expects the indexes to be empty.
+
+    const std::size_t nstations = stations.size();
+
+    auto section = [&](SnapshotSection type) -> SnapshotReader*
+    {
+      auto pos = sections.find(type);
+      return (pos != sections.end() ? &pos->second : nullptr);
+    };
+
+    auto* grid = section(SnapshotSection::Grid);
+    bool complete = (grid != nullptr);
+    for (auto type : {SnapshotSection::FmisidIndex,
+                      SnapshotSection::WmoIndex,
+                      SnapshotSection::LpnnIndex,
+                      SnapshotSection::RwsidIndex,
+                      SnapshotSection::WsiIndex,
+                      SnapshotSection::GroupMembers,
+                      SnapshotSection::RoadFmisids,
+                      SnapshotSection::ForeignFmisids})
+      complete &= (section(type) != nullptr);
+
+    if (complete && grid->read<std::uint32_t>() == grid_columns &&
+        grid->read<std::uint32_t>() == grid_rows)
+    {
+      read_index(*section(SnapshotSection::FmisidIndex), nstations, fmisidstations);
+      read_index(*section(SnapshotSection::WmoIndex), nstations, wmostations);
+      read_index(*section(SnapshotSection::LpnnIndex), nstations, lpnnstations);
+      read_index(*section(SnapshotSection::RwsidIndex), nstations, rwsidstations);
+      read_index(*section(SnapshotSection::WsiIndex), nstations, wsistations);
+      read_index(*section(SnapshotSection::GroupMembers), nstations, members);
+      read_fmisids(*section(SnapshotSection::RoadFmisids), roadfmisids);
+      read_fmisids(*section(SnapshotSection::ForeignFmisids), foreignfmisids);
+
+      boxgrid.offsets.resize(grid_cells + 1);
+      for (auto& offset : boxgrid.offsets)
+        offset = grid->read<std::uint32_t>();
+      const std::size_t ngridids = boxgrid.offsets.back();
+      if (boxgrid.offsets.front() != 0 || 4 * ngridids != grid->remaining() ||
+          !std::is_sorted(boxgrid.offsets.begin(), boxgrid.offsets.end()))
+        throw Fmi::Exception(BCP, "Station snapshot contains an invalid search grid");
+      boxgrid.ids.resize(ngridids);
+      for (auto& id : boxgrid.ids)
+        id = read_station_id(*grid, nstations);
+
+      // The near tree has no flat representation and is always rebuilt
+      updateTree();
+      updateGroups();
+      updateNames();
+      itsLayout = next_layout();
+    }
+    else
+      update();
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Reading station snapshot failed!")
+        .addParameter("Filename", filename);
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Update search structures
@@ -857,61 +1513,165 @@ Spine::Stations StationInfo::findStationsInsideBox(double minx,
 
 void StationInfo::update() const
 {
-  // Make a mapping from fmisid to the indexes of respective stations
+  // The indexes have already been built
+  if (itsLayout != 0)
+    return;
+
+  // Make mappings from the identifiers to the indexes of respective stations
+
+  updateIndexes();
+
+  // Map groups to sets of stations
 
   for (std::size_t idx = 0; idx < stations.size(); ++idx)
   {
     const auto& station = stations[idx];
-    if (station.fmisid > 0)
-      fmisidstations[station.fmisid].insert(idx);
+    members[station.type].insert(idx);
   }
 
-  // Make a mapping from wmo to the indexes of respective stations
+  // Create a latlon search tree for the stations
 
-  for (std::size_t idx = 0; idx < stations.size(); ++idx)
+  updateTree();
+
+  // Create a grid for bounding box searches. The cells are filled in ascending station order.
+
+  std::vector<std::size_t> cells(stations.size(), grid_cells);
+  boxgrid.offsets.assign(grid_cells + 1, 0);
+  for (StationID idx = 0; idx < stations.size(); ++idx)
   {
     const auto& station = stations[idx];
-    if (station.wmo > 0)
-      wmostations[station.wmo].insert(idx);
+    if (std::isfinite(station.longitude) && std::isfinite(station.latitude))
+    {
+      cells[idx] = grid_row(station.latitude) * grid_columns + grid_column(station.longitude);
+      ++boxgrid.offsets[cells[idx] + 1];
+    }
   }
 
-  // Make a mapping from lpnn to the indexes of respective stations
+  for (std::size_t cell = 0; cell < grid_cells; ++cell)
+    boxgrid.offsets[cell + 1] += boxgrid.offsets[cell];
 
-  for (std::size_t idx = 0; idx < stations.size(); ++idx)
+  boxgrid.ids.resize(boxgrid.offsets.back());
+  auto next = boxgrid.offsets;
+  for (StationID idx = 0; idx < stations.size(); ++idx)
+    if (cells[idx] < grid_cells)
+      boxgrid.ids[next[cells[idx]]++] = idx;
+
+  // Determine quickly type of external stations
+
+  for (const auto& station : stations)
   {
-    const auto& station = stations[idx];
-    if (station.lpnn > 0)
-      lpnnstations[station.lpnn].insert(idx);
+    if (station.isRoad)
+      roadfmisids.insert(station.fmisid);
+    else if (station.isForeign)
+      foreignfmisids.insert(station.fmisid);
   }
 
-  // Make a mapping from rwsid to the indexes of respective stations
+  // Group masks for fast group membership tests
 
-  for (std::size_t idx = 0; idx < stations.size(); ++idx)
+  updateGroups();
+
+  // Trigram index for name searches
+
+  updateNames();
+
+  itsLayout = next_layout();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create the identifier indexes
+ */
+// ----------------------------------------------------------------------
+
+void StationInfo::updateIndexes() const
+{
+  std::vector<StationIndex::Entry> fmisids;
+  std::vector<StationIndex::Entry> wmos;
+  std::vector<StationIndex::Entry> lpnns;
+  std::vector<StationIndex::Entry> rwsids;
+  std::vector<NamedStationIndex::Entry> wsis;
+
+  for (StationID idx = 0; idx < stations.size(); ++idx)
   {
     const auto& station = stations[idx];
+    if (station.fmisid > 0)
+      fmisids.emplace_back(station.fmisid, idx);
+    if (station.wmo > 0)
+      wmos.emplace_back(station.wmo, idx);
+    if (station.lpnn > 0)
+      lpnns.emplace_back(station.lpnn, idx);
     if (station.rwsid > 0)
-      rwsidstations[station.rwsid].insert(idx);
+      rwsids.emplace_back(station.rwsid, idx);
+    if (!station.wsi.empty())
+      wsis.emplace_back(station.wsi, idx);
   }
 
-  // Make a mapping from wsi to the indexes of respective stations
+  fmisidstations.assign(std::move(fmisids));
+  wmostations.assign(std::move(wmos));
+  lpnnstations.assign(std::move(lpnns));
+  rwsidstations.assign(std::move(rwsids));
+  wsistations.assign(std::move(wsis));
+}
 
-  for (std::size_t idx = 0; idx < stations.size(); ++idx)
+// ----------------------------------------------------------------------
+/*!
+ * \brief Intern the station groups into bit positions
+ */
+// ----------------------------------------------------------------------
+
+void StationInfo::updateGroups() const
+{
+  groupbits.clear();
+  stationgroupbit.clear();
+  fmisidgroups.clear();
+
+  stationgroupbit.reserve(stations.size());
+  for (const auto& station : stations)
   {
-    const auto& station = stations[idx];
-    if (!station.wsi.empty())
-      wsistations[station.wsi].insert(idx);
+    auto pos = groupbits.find(station.type);
+    if (pos == groupbits.end())
+    {
+      const auto bit = std::min<std::size_t>(groupbits.size(), shared_group_bit);
+      pos = groupbits.emplace(station.type, bit).first;
+    }
+
+    stationgroupbit.push_back(pos->second);
+    if (station.fmisid > 0)
+      fmisidgroups[station.fmisid].set(pos->second);
   }
+}
 
-  // Map groups to sets of stations
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create the trigram index of the case folded station names
+ */
+// ----------------------------------------------------------------------
 
-  for (std::size_t idx = 0; idx < stations.size(); ++idx)
+void StationInfo::updateNames() const
+{
+  foldednames.clear();
+  foldednames.reserve(stations.size());
+
+  std::vector<StationIndex::Entry> trigrams;
+  for (StationID idx = 0; idx < stations.size(); ++idx)
   {
-    const auto& station = stations[idx];
-    members[station.type].insert(idx);
+    foldednames.push_back(Fmi::ascii_toupper_copy(stations[idx].formal_name_fi));
+    const auto& name = foldednames.back();
+    for (std::size_t pos = 0; pos + 3 <= name.size(); ++pos)
+      trigrams.emplace_back(name_trigram(name, pos), idx);
   }
 
-  // Create a latlon search tree for the stations
+  nametrigrams.assign(std::move(trigrams));
+}
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create the latlon search tree
+ */
+// ----------------------------------------------------------------------
+
+void StationInfo::updateTree() const
+{
   for (StationID idx = 0; idx < stations.size(); ++idx)
   {
     const auto& station = stations[idx];
@@ -919,15 +1679,98 @@ void StationInfo::update() const
   }
 
   stationtree.flush();
+}
 
-  // Determine quickly type of external stations
+// ----------------------------------------------------------------------
+/*!
+ * \brief Replace the rows of changed stations
+ */
+// ----------------------------------------------------------------------
 
-  for (const auto& station : stations)
+std::shared_ptr<StationInfo> StationInfo::patch(const std::set<int>& fmisids,
+                                                const Spine::Stations& rows) const
+{
+  try
   {
-    if (station.isRoad)
-      roadfmisids.insert(station.fmisid);
-    else if (station.isForeign)
-      foreignfmisids.insert(station.fmisid);
+    auto info = std::make_shared<StationInfo>();
+    info->itsStationGroups = itsStationGroups;
+
+    std::map<int, std::vector<const Spine::Station*>> newrows;
+    for (auto fmisid : fmisids)
+      newrows[fmisid];
+    for (const auto& station : rows)
+      newrows[station.fmisid].push_back(&station);
+
+    // The layout is kept if the new rows of each station can replace the old rows one by one
+
+    bool samelayout = (itsLayout != 0);
+    for (const auto& fmisid_rows : newrows)
+    {
+      if (!samelayout)
+        break;
+      const auto ids = fmisidstations.find(fmisid_rows.first);
+      samelayout = (ids.size() == fmisid_rows.second.size());
+      if (samelayout)
+      {
+        const auto* id = ids.begin();
+        for (const auto* station : fmisid_rows.second)
+        {
+          const auto& old = stations[*id++];
+          samelayout &=
+              (old.longitude == station->longitude && old.latitude == station->latitude);
+        }
+      }
+    }
+
+    if (!samelayout)
+    {
+      for (const auto& station : stations)
+        if (newrows.find(station.fmisid) == newrows.end())
+          info->stations.push_back(station);
+      info->stations.insert(info->stations.end(), rows.begin(), rows.end());
+      info->update();
+      return info;
+    }
+
+    info->stations = stations;
+    info->members = members;
+    info->boxgrid = boxgrid;
+    info->roadfmisids = roadfmisids;
+    info->foreignfmisids = foreignfmisids;
+
+    for (const auto& fmisid_rows : newrows)
+    {
+      const auto fmisid = fmisid_rows.first;
+      info->roadfmisids.erase(fmisid);
+      info->foreignfmisids.erase(fmisid);
+
+      const auto* id = fmisidstations.find(fmisid).begin();
+      for (const auto* station : fmisid_rows.second)
+      {
+        const auto idx = *id++;
+        erase_station(info->members, stations[idx].type, idx);
+        info->stations[idx] = *station;
+        info->members[station->type].insert(idx);
+
+        if (station->isRoad)
+          info->roadfmisids.insert(fmisid);
+        else if (station->isForeign)
+          info->foreignfmisids.insert(fmisid);
+      }
+    }
+
+    // The flat indexes are rebuilt in one pass. The coordinates did not change, but the
+    // tree cannot be copied.
+    info->updateIndexes();
+    info->updateTree();
+    info->updateGroups();
+    info->updateNames();
+    info->itsLayout = itsLayout;
+    return info;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
 
@@ -1003,11 +1846,82 @@ Spine::TaggedFMISIDList StationInfo::translateWSIToFMISID(const std::vector<std:
   return ret;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find stations by a part of the name
+ *
+ * Stations containing all the trigrams of the text are candidates, which are then
+ * compared with the text. Texts shorter than a trigram are compared with all names.
+ */
+// ----------------------------------------------------------------------
+
+std::set<int> StationInfo::findFmisidsByName(const std::string& text, bool prefix) const
+{
+  try
+  {
+    std::set<int> ret;
+
+    const auto pattern = Fmi::ascii_toupper_copy(text);
+    auto check = [&](StationID idx)
+    {
+      const auto& name = foldednames[idx];
+      if (prefix ? name.compare(0, pattern.size(), pattern) == 0
+                 : name.find(pattern) != std::string::npos)
+        ret.insert(stations[idx].fmisid);
+    };
+
+    if (pattern.size() < 3)
+    {
+      for (StationID idx = 0; idx < foldednames.size(); ++idx)
+        check(idx);
+      return ret;
+    }
+
+    std::vector<StationIndex::Range> ranges;
+    for (std::size_t pos = 0; pos + 3 <= pattern.size(); ++pos)
+    {
+      const auto range = nametrigrams.find(name_trigram(pattern, pos));
+      if (range.empty())
+        return ret;
+      ranges.push_back(range);
+    }
+
+    // Intersect starting from the rarest trigram
+    std::sort(ranges.begin(),
+              ranges.end(),
+              [](const StationIndex::Range& lhs, const StationIndex::Range& rhs)
+              { return lhs.size() < rhs.size(); });
+
+    std::vector<StationID> candidates(ranges.front().begin(), ranges.front().end());
+    std::vector<StationID> common;
+    for (std::size_t i = 1; i < ranges.size() && !candidates.empty(); ++i)
+    {
+      common.clear();
+      std::set_intersection(candidates.begin(),
+                            candidates.end(),
+                            ranges[i].begin(),
+                            ranges[i].end(),
+                            std::back_inserter(common));
+      candidates.swap(common);
+    }
+
+    for (auto idx : candidates)
+      check(idx);
+
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 std::vector<int> StationInfo::fmisids() const
 {
   std::vector<int> ret;
-  for (const auto& fmisid_data : fmisidstations)
-    ret.push_back(fmisid_data.first);
+  ret.reserve(fmisidstations.size());
+  for (std::size_t i = 0; i < fmisidstations.size(); ++i)
+    ret.push_back(fmisidstations.key(i));
   return ret;
 }
 
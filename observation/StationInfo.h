@@ -4,8 +4,14 @@
 #include <macgyver/NearTree.h>
 #include <macgyver/NearTreeLatLon.h>
 #include <spine/Station.h>
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <ostream>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -25,13 +31,122 @@ using StationID = unsigned int;
 using NearestCandidate = std::pair<double, StationID>;
 using NearestCandidateList = std::vector<NearestCandidate>;
 
-// Mapping from some identifier to stations
-using StationIndex = std::map<unsigned int, std::set<StationID>>;
-using NamedStationIndex = std::map<std::string, std::set<StationID>>;
+// Mapping from some identifier to stations in sorted flat arrays. The stations of the i'th key
+// are ids[offsets[i]] ... ids[offsets[i+1]-1] in ascending order.
+template <typename Key>
+class FlatStationIndex
+{
+ public:
+  using Entry = std::pair<Key, StationID>;
+
+  // Stations of one key
+  class Range
+  {
+   public:
+    Range() = default;
+    Range(const StationID* first, const StationID* last) : itsFirst(first), itsLast(last) {}
+
+    const StationID* begin() const { return itsFirst; }
+    const StationID* end() const { return itsLast; }
+    std::size_t size() const { return itsLast - itsFirst; }
+    bool empty() const { return itsFirst == itsLast; }
+
+   private:
+    const StationID* itsFirst = nullptr;
+    const StationID* itsLast = nullptr;
+  };
+
+  // Replace the contents, duplicate entries are ignored
+  void assign(std::vector<Entry> entries)
+  {
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    itsKeys.clear();
+    itsOffsets.clear();
+    itsIds.clear();
+    itsIds.reserve(entries.size());
+
+    for (auto& entry : entries)
+    {
+      if (itsKeys.empty() || itsKeys.back() != entry.first)
+      {
+        itsKeys.push_back(std::move(entry.first));
+        itsOffsets.push_back(itsIds.size());
+      }
+      itsIds.push_back(entry.second);
+    }
+    itsOffsets.push_back(itsIds.size());
+  }
+
+  // Replace the contents with arrays which are already in the layout above. Returns false
+  // without changing anything if the keys or the stations of some key are not strictly
+  // ascending, or if the offsets do not match the stations.
+  bool assignSorted(std::vector<Key> keys,
+                    std::vector<StationID> offsets,
+                    std::vector<StationID> ids)
+  {
+    if (offsets.size() != keys.size() + 1 || offsets.front() != 0 || offsets.back() != ids.size())
+      return false;
+
+    for (std::size_t i = 0; i < keys.size(); i++)
+    {
+      if (i > 0 && !(keys[i - 1] < keys[i]))
+        return false;
+      if (offsets[i] >= offsets[i + 1])
+        return false;
+      for (auto j = offsets[i] + 1; j < offsets[i + 1]; j++)
+        if (ids[j - 1] >= ids[j])
+          return false;
+    }
+
+    itsKeys = std::move(keys);
+    itsOffsets = std::move(offsets);
+    itsIds = std::move(ids);
+    return true;
+  }
+
+  std::size_t size() const { return itsKeys.size(); }
+  const Key& key(std::size_t i) const { return itsKeys[i]; }
+  Range stations(std::size_t i) const
+  {
+    return {itsIds.data() + itsOffsets[i], itsIds.data() + itsOffsets[i + 1]};
+  }
+
+  // Empty range for unknown keys
+  Range find(const Key& key) const
+  {
+    const auto pos = std::lower_bound(itsKeys.begin(), itsKeys.end(), key);
+    if (pos == itsKeys.end() || *pos != key)
+      return {};
+    return stations(pos - itsKeys.begin());
+  }
+
+ private:
+  std::vector<Key> itsKeys;
+  std::vector<StationID> itsOffsets;
+  std::vector<StationID> itsIds;
+};
+
+using StationIndex = FlatStationIndex<unsigned int>;
+using NamedStationIndex = FlatStationIndex<std::string>;
 
 // We store the index into a vector along with the coordinates
 using StationNearTreeLatLon = Fmi::NearTreeLatLon<StationID>;
 
+// Station groups interned into bit positions. If there are more groups than bits, the extra
+// groups share the last bit and are compared by name.
+using StationGroupBits = std::bitset<128>;
+
+// Station groups of a query translated by StationInfo::groupMask. The mask is valid only for
+// the StationInfo which created it.
+struct StationGroupMask
+{
+  bool all = true;               // no group restrictions
+  StationGroupBits bits;         // requested groups
+  std::set<std::string> shared;  // requested groups sharing the last bit
+};
+
 /*!
  * \brief Central holder for current station information.
  *
@@ -49,11 +164,25 @@ class StationInfo
   Spine::Stations stations;  // all known stations
   // StationLocations stationLocations;  // all station locations
 
+  // Files ending with .txt or .xml are boost text or XML archives of the stations. Other
+  // files are binary snapshots of the stations and the prebuilt search indexes, older
+  // boost binary archives are still accepted when unserializing.
   void serialize(const std::string& filename) const;
   void unserialize(const std::string& filename);
 
   std::vector<int> fmisids() const;
 
+  // Copy of the stations where the rows of the given stations are replaced by the new rows.
+  // Stations in the set without new rows are removed. If the changed stations keep their
+  // number of rows and coordinates, the indexes are patched and the StationIDs stay the same,
+  // otherwise the indexes are rebuilt.
+  std::shared_ptr<StationInfo> patch(const std::set<int>& fmisids,
+                                     const Spine::Stations& rows) const;
+
+  // Identifies the StationIDs and coordinates of the stations. Patched copies which keep them
+  // have the same layout, and nearest-station candidate lists may be shared between them.
+  std::uint64_t layout() const { return itsLayout; }
+
   Spine::Stations findNearestStations(double longitude,
                                       double latitude,
                                       double maxdistance,
@@ -135,12 +264,20 @@ class StationInfo
                                         const Fmi::DateTime& starttime,
                                         const Fmi::DateTime& endtime) const;
 
+  // Fmisids of the stations whose Finnish name contains the text case insensitively. With
+  // prefix=true the name must start with the text.
+  std::set<int> findFmisidsByName(const std::string& text, bool prefix = false) const;
+
   const Spine::Station& getStation(unsigned int fmisid,
                                    const std::set<std::string>& groups,
                                    const Fmi::DateTime& t) const;
 
   bool belongsToGroup(unsigned int fmisid, const std::set<std::string>& groups) const;
 
+  // Translate the groups once and test the stations with the mask
+  StationGroupMask groupMask(const std::set<std::string>& groups) const;
+  bool belongsToGroup(unsigned int fmisid, const StationGroupMask& mask) const;
+
   Spine::TaggedFMISIDList translateWMOToFMISID(const std::vector<int>& wmos,
                                                const Fmi::DateTime& t) const;
   Spine::TaggedFMISIDList translateRWSIDToFMISID(const std::vector<int>& rwsids,
@@ -159,6 +296,13 @@ class StationInfo
 
  private:
   void update() const;
+  void updateIndexes() const;
+  void updateTree() const;
+  void updateGroups() const;
+  void updateNames() const;
+  bool groupOk(StationID id, const StationGroupMask& mask) const;
+  void writeSnapshot(std::ostream& out) const;
+  bool readSnapshot(const std::string& filename);
 
   // Mapping from coordinates to stations
   using StationTree =
@@ -167,6 +311,16 @@ class StationInfo
   // Members of station groups
   using GroupMembers = std::map<std::string, std::set<StationID>>;
 
+  // Regular grid of 1x1 degree cells for bounding box searches. The stations of cell c are
+  // ids[offsets[c]] ... ids[offsets[c+1]-1] in ascending order.
+  struct BoxGrid
+  {
+    std::vector<StationID> offsets;
+    std::vector<StationID> ids;
+  };
+
+  std::vector<StationID> searchStations(double minx, double miny, double maxx, double maxy) const;
+
   mutable StationIndex fmisidstations;    // fmisid --> indexes of stations
   mutable StationIndex wmostations;       // wmo --> indexes of stations
   mutable StationIndex lpnnstations;      // lpnn --> indexes of stations
@@ -174,10 +328,20 @@ class StationInfo
   mutable NamedStationIndex wsistations;  // wsi --> indexes of stations
   mutable StationTree stationtree;        // search tree for nearest stations
   mutable GroupMembers members;           // group id --> indexes of stations
+  mutable BoxGrid boxgrid;                // grid cell --> indexes of stations
+  mutable StationIndex nametrigrams;      // name trigram --> indexes of stations
+
+  mutable std::vector<std::string> foldednames;  // index --> upper case Finnish name
+
+  mutable std::map<std::string, unsigned int> groupbits;          // group --> bit position
+  mutable std::vector<unsigned char> stationgroupbit;             // index --> bit of the group
+  mutable std::map<unsigned int, StationGroupBits> fmisidgroups;  // fmisid --> groups
 
   mutable std::set<int> roadfmisids;     // all stations where isRoad=true
   mutable std::set<int> foreignfmisids;  // all stations where isForeign=true
 
+  mutable std::uint64_t itsLayout = 0;  // zero until the indexes have been built
+
   StationGroups itsStationGroups;
 };
 
@@ -0,0 +1,26 @@
+#include "TableGenerations.h"
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+std::size_t TableGenerations::get(const std::string& tablename) const
+{
+  Spine::ReadLock lock(itsMutex);
+  auto it = itsGenerations.find(tablename);
+  if (it == itsGenerations.end())
+    return 0;
+  return it->second;
+}
+
+void TableGenerations::increment(const std::string& tablename)
+{
+  Spine::WriteLock lock(itsMutex);
+  ++itsGenerations[tablename];
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <spine/Thread.h>
+#include <map>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// Generation counters for the cached database tables. The cache update loops increment
+// the counter of a table whenever new data has been written into it, results computed
+// from the table earlier can then be recognized as outdated.
+
+class TableGenerations
+{
+ public:
+  std::size_t get(const std::string& tablename) const;
+  void increment(const std::string& tablename);
+
+ private:
+  mutable Spine::MutexType itsMutex;
+  std::map<std::string, std::size_t> itsGenerations;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -531,6 +531,150 @@ bool isParameterVariant(const std::string& name, const ParameterMap& parameterMa
   }
 }
 
+std::size_t addFmisidParameter(std::vector<Spine::Parameter>& parameters, bool& added)
+{
+  try
+  {
+    for (std::size_t i = 0; i < parameters.size(); i++)
+    {
+      if (Fmi::ascii_tolower_copy(parameters[i].name()) == "fmisid")
+      {
+        added = false;
+        return i;
+      }
+    }
+
+    parameters.emplace_back("fmisid", Spine::Parameter::Type::DataIndependent);
+    added = true;
+    return parameters.size() - 1;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::vector<StationRows> stationRowRanges(const TS::TimeSeries& fmisids)
+{
+  try
+  {
+    std::vector<StationRows> ret;
+    std::size_t begin = 0;
+    while (begin < fmisids.size())
+    {
+      // Compare the values directly, and as strings only at run boundaries
+      const auto &first = fmisids[begin].value;
+      auto fmisid = getStringValue(first);
+      std::size_t end = begin + 1;
+      while (end < fmisids.size() && (fmisids[end].value == first ||
+                                      getStringValue(fmisids[end].value) == fmisid))
+        ++end;
+      ret.push_back(StationRows{std::move(fmisid), begin, end});
+      begin = end;
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+TS::TimeSeriesVectorPtr mergeStationTimeSeries(const TS::TimeSeriesVectorPtr& head,
+                                               const TS::TimeSeriesVectorPtr& tail,
+                                               std::size_t fmisidIndex)
+{
+  try
+  {
+    if (!head || head->size() <= fmisidIndex || head->at(fmisidIndex).empty())
+      return tail;
+    if (!tail || tail->size() <= fmisidIndex || tail->at(fmisidIndex).empty())
+      return head;
+
+    if (head->size() != tail->size())
+      throw Fmi::Exception(BCP, "Cannot merge results with different number of parameters")
+          .addParameter("head", Fmi::to_string(head->size()))
+          .addParameter("tail", Fmi::to_string(tail->size()));
+
+    using RowRanges = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    // Row ranges of each station in the order the stations first appear
+    std::vector<std::pair<RowRanges, RowRanges>> stationRows;
+    std::unordered_map<std::string, std::size_t> stationPositions;
+
+    auto collectRows = [&](const TS::TimeSeries& fmisids, bool isHead)
+    {
+      for (const auto& range : stationRowRanges(fmisids))
+      {
+        auto pos = stationPositions.emplace(range.fmisid, stationRows.size());
+        if (pos.second)
+          stationRows.emplace_back();
+        auto& rows = stationRows[pos.first->second];
+        (isHead ? rows.first : rows.second).emplace_back(range.begin, range.end);
+      }
+    };
+
+    collectRows(head->at(fmisidIndex), true);
+    collectRows(tail->at(fmisidIndex), false);
+
+    TS::TimeSeriesVectorPtr ret = std::make_shared<TS::TimeSeriesVector>();
+    for (std::size_t i = 0; i < head->size(); i++)
+    {
+      const TS::TimeSeries& headSeries = head->at(i);
+      const TS::TimeSeries& tailSeries = tail->at(i);
+      TS::TimeSeries merged;
+      merged.reserve(headSeries.size() + tailSeries.size());
+      for (const auto& rows : stationRows)
+      {
+        for (const auto& range : rows.first)
+          merged.insert(merged.end(),
+                        headSeries.begin() + range.first,
+                        headSeries.begin() + range.second);
+        for (const auto& range : rows.second)
+          merged.insert(merged.end(),
+                        tailSeries.begin() + range.first,
+                        tailSeries.begin() + range.second);
+      }
+      ret->emplace_back(std::move(merged));
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+Fmi::DateTime hybridQuerySplitTime(const Settings& settings,
+                                   const Fmi::DateTime& cacheStart,
+                                   const Fmi::TimeDuration& margin)
+{
+  try
+  {
+    if (settings.aggregation || cacheStart.is_not_a_date_time() ||
+        settings.starttime.is_not_a_date_time() || settings.endtime.is_not_a_date_time())
+      return Fmi::DateTime::NOT_A_DATE_TIME;
+
+    Fmi::DateTime splitTime = cacheStart + margin;
+    if (settings.timestep > 1 && splitTime > settings.starttime)
+    {
+      const long step = 60L * settings.timestep;
+      const long offset = (splitTime - settings.starttime).total_seconds();
+      const long steps = (offset + step - 1) / step;
+      splitTime = settings.starttime + Fmi::Seconds(steps * step);
+    }
+
+    if (splitTime <= settings.starttime || splitTime > settings.endtime)
+      return Fmi::DateTime::NOT_A_DATE_TIME;
+
+    return splitTime;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 }  // namespace Utils
 }  // namespace Observation
 }  // namespace Engine
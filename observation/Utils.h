@@ -150,6 +150,66 @@ bool isParameter(const std::string& name,
 
 bool isParameterVariant(const std::string& name, const ParameterMap& parameterMap);
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index of the fmisid parameter, the parameter is appended if missing
+ *
+ * \a added is set to true if the parameter had to be appended.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t addFmisidParameter(std::vector<Spine::Parameter>& parameters, bool& added);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Consecutive result rows of one station
+ */
+// ----------------------------------------------------------------------
+
+struct StationRows
+{
+  std::string fmisid;
+  std::size_t begin = 0;
+  std::size_t end = 0;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Split the rows of a result into runs of the same station
+ */
+// ----------------------------------------------------------------------
+
+std::vector<StationRows> stationRowRanges(const TS::TimeSeries& fmisids);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Merge results of two consecutive time intervals station by station
+ *
+ * Both results must have the same parameters. The rows of each station in
+ * \a head are placed before the rows of the same station in \a tail.
+ * The column at \a fmisidIndex identifies the station.
+ */
+// ----------------------------------------------------------------------
+
+TS::TimeSeriesVectorPtr mergeStationTimeSeries(const TS::TimeSeriesVectorPtr& head,
+                                               const TS::TimeSeriesVectorPtr& tail,
+                                               std::size_t fmisidIndex);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start of the cached part of a hybrid database and cache query
+ *
+ * The time is the first time on the timestep grid of the query at least
+ * \a margin after the start of the cached interval. Returns NOT_A_DATE_TIME
+ * if the query cannot be split. Aggregated queries are never split, since a
+ * time bucket straddling the split would be aggregated in both parts.
+ */
+// ----------------------------------------------------------------------
+
+Fmi::DateTime hybridQuerySplitTime(const Settings& settings,
+                                   const Fmi::DateTime& cacheStart,
+                                   const Fmi::TimeDuration& margin);
+
 }  // namespace Utils
 }  // namespace Observation
 }  // namespace Engine
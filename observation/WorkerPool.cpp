@@ -0,0 +1,134 @@
+#include "WorkerPool.h"
+#include <macgyver/Exception.h>
+#include <atomic>
+#include <exception>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+struct WorkerPool::Batch
+{
+  Batch(std::size_t n, const std::function<void(std::size_t)> &t) : size(n), task(t), errors(n) {}
+
+  bool exhausted() const { return next >= size; }
+
+  const std::size_t size;
+  const std::function<void(std::size_t)> &task;  // valid until all parts have finished
+  std::atomic<std::size_t> next{0};
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::size_t finished = 0;
+  std::vector<std::exception_ptr> errors;
+};
+
+WorkerPool::WorkerPool(std::size_t threads)
+{
+  try
+  {
+    itsThreads.reserve(threads);
+    for (std::size_t i = 0; i < threads; i++)
+      itsThreads.emplace_back([this]() { work(); });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsStopping = true;
+  }
+  itsCondition.notify_all();
+  for (auto &thread : itsThreads)
+    thread.join();
+}
+
+// Process parts of the batch until all of them have been taken
+void WorkerPool::process(Batch &batch)
+{
+  for (std::size_t i = batch.next++; i < batch.size; i = batch.next++)
+  {
+    try
+    {
+      batch.task(i);
+    }
+    catch (...)
+    {
+      batch.errors[i] = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    if (++batch.finished == batch.size)
+      batch.condition.notify_all();
+  }
+}
+
+void WorkerPool::work()
+{
+  while (true)
+  {
+    std::shared_ptr<Batch> batch;
+    {
+      std::unique_lock<std::mutex> lock(itsMutex);
+      while (true)
+      {
+        while (!itsQueue.empty() && itsQueue.front()->exhausted())
+          itsQueue.pop_front();
+        if (itsStopping)
+          return;
+        if (!itsQueue.empty())
+          break;
+        itsCondition.wait(lock);
+      }
+      // The batch stays queued so that the other workers may join in
+      batch = itsQueue.front();
+    }
+    process(*batch);
+  }
+}
+
+void WorkerPool::run(std::size_t n, const std::function<void(std::size_t)> &task)
+{
+  try
+  {
+    if (n == 0)
+      return;
+
+    auto batch = std::make_shared<Batch>(n, task);
+
+    if (n > 1 && !itsThreads.empty())
+    {
+      {
+        std::lock_guard<std::mutex> lock(itsMutex);
+        itsQueue.push_back(batch);
+      }
+      itsCondition.notify_all();
+    }
+
+    process(*batch);
+
+    {
+      std::unique_lock<std::mutex> lock(batch->mutex);
+      batch->condition.wait(lock, [&batch]() { return batch->finished == batch->size; });
+    }
+
+    for (const auto &error : batch->errors)
+      if (error)
+        std::rethrow_exception(error);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
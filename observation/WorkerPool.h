@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+// A fixed number of worker threads shared by all queries. A query splits its work into parts
+// which the workers and the calling thread process together. The caller always takes part, hence
+// its parts are completed even when all the workers are busy with other queries, and the total
+// number of threads used for parallel processing stays bounded by the pool size.
+
+class WorkerPool
+{
+ public:
+  explicit WorkerPool(std::size_t threads);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &other) = delete;
+  WorkerPool(WorkerPool &&other) = delete;
+  WorkerPool &operator=(const WorkerPool &other) = delete;
+  WorkerPool &operator=(WorkerPool &&other) = delete;
+
+  std::size_t size() const { return itsThreads.size(); }
+
+  // Run task(0) ... task(n-1) and wait for all of them to finish. The exception of the first
+  // failed part is rethrown.
+  void run(std::size_t n, const std::function<void(std::size_t)> &task);
+
+ private:
+  struct Batch;
+
+  void work();
+  static void process(Batch &batch);
+
+  std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  std::deque<std::shared_ptr<Batch>> itsQueue;
+  bool itsStopping = false;
+  std::vector<std::thread> itsThreads;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
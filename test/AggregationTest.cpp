@@ -0,0 +1,174 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "Aggregation.h"
+#include <macgyver/DateTime.h>
+
+using namespace SmartMet;
+using namespace SmartMet::Engine::Observation;
+
+namespace
+{
+Fmi::DateTime t(const char* str)
+{
+  return Fmi::DateTime::from_string(str);
+}
+
+LocationDataItem make_obs(int fmisid,
+                          int measurand_id,
+                          const char* time,
+                          std::optional<double> value,
+                          int quality = 1)
+{
+  LocationDataItem obs;
+  obs.data.fmisid = fmisid;
+  obs.data.measurand_id = measurand_id;
+  obs.data.data_time = t(time);
+  obs.data.data_value = value;
+  obs.data.data_quality = quality;
+  return obs;
+}
+
+AggregationSpec make_spec(AggregationSpec::Function function, int interval = 60)
+{
+  AggregationSpec spec;
+  spec.function = function;
+  spec.interval = interval;
+  return spec;
+}
+
+}  // namespace
+
+TEST_CASE("Aggregation bucket times")
+{
+  const auto spec = make_spec(AggregationSpec::Function::Mean);
+
+  REQUIRE(aggregationBucketSeconds(spec) == 3600);
+  REQUIRE_THROWS(aggregationBucketSeconds(make_spec(AggregationSpec::Function::Mean, 0)));
+
+  // The first and the last complete bucket at the given time
+  REQUIRE(aggregationStartTime(t("2024-01-01 00:30:00"), spec) == t("2024-01-01 01:00:00"));
+  REQUIRE(aggregationStartTime(t("2024-01-01 01:00:00"), spec) == t("2024-01-01 01:00:00"));
+  REQUIRE(aggregationEndTime(t("2024-01-01 01:30:00"), spec) == t("2024-01-01 01:00:00"));
+  REQUIRE(aggregationEndTime(t("2024-01-01 01:00:00"), spec) == t("2024-01-01 01:00:00"));
+}
+
+TEST_CASE("Aggregating observations")
+{
+  // Buckets (00:00,01:00] and (01:00,02:00] of one station and measurand
+  const LocationDataItems observations{make_obs(1, 1, "2024-01-01 00:10:00", 1.0),
+                                       make_obs(1, 1, "2024-01-01 00:50:00", 3.0, 2),
+                                       make_obs(1, 1, "2024-01-01 01:00:00", 5.0),
+                                       make_obs(1, 1, "2024-01-01 01:20:00", 7.0),
+                                       make_obs(1, 1, "2024-01-01 01:40:00", {}, 9)};
+  const auto starttime = t("2024-01-01 00:00:00");
+  const auto endtime = t("2024-01-01 02:00:00");
+
+  SECTION("Rows are labelled with the bucket end")
+  {
+    const auto ret = aggregateObservations(
+        observations, make_spec(AggregationSpec::Function::Mean), starttime, endtime);
+    REQUIRE(ret.size() == 2);
+    REQUIRE(ret[0].data.data_time == t("2024-01-01 01:00:00"));
+    REQUIRE(*ret[0].data.data_value == Approx(3.0));
+    REQUIRE(ret[0].data.data_quality == 2);
+
+    // Missing values are ignored, but their quality is not
+    REQUIRE(ret[1].data.data_time == t("2024-01-01 02:00:00"));
+    REQUIRE(*ret[1].data.data_value == Approx(7.0));
+    REQUIRE(ret[1].data.data_quality == 9);
+  }
+
+  SECTION("Aggregate functions")
+  {
+    auto ret = aggregateObservations(
+        observations, make_spec(AggregationSpec::Function::Min), starttime, endtime);
+    REQUIRE(*ret[0].data.data_value == Approx(1.0));
+
+    ret = aggregateObservations(
+        observations, make_spec(AggregationSpec::Function::Max), starttime, endtime);
+    REQUIRE(*ret[0].data.data_value == Approx(5.0));
+
+    ret = aggregateObservations(
+        observations, make_spec(AggregationSpec::Function::Sum), starttime, endtime);
+    REQUIRE(*ret[0].data.data_value == Approx(9.0));
+  }
+
+  SECTION("Buckets ending after the end time are dropped")
+  {
+    const auto ret = aggregateObservations(observations,
+                                           make_spec(AggregationSpec::Function::Mean),
+                                           starttime,
+                                           t("2024-01-01 01:30:00"));
+    REQUIRE(ret.size() == 1);
+    REQUIRE(ret[0].data.data_time == t("2024-01-01 01:00:00"));
+  }
+
+  SECTION("Buckets starting before the start time are dropped")
+  {
+    // The bucket ending at 01:00 would contain only the observations after 00:30
+    const auto spec = make_spec(AggregationSpec::Function::Mean);
+    auto ret = aggregateObservations(observations, spec, t("2024-01-01 00:30:00"), endtime);
+    REQUIRE(ret.size() == 1);
+    REQUIRE(ret[0].data.data_time == t("2024-01-01 02:00:00"));
+
+    // The observation at the start of a bucket belongs to the previous bucket
+    ret = aggregateObservations(observations, spec, t("2024-01-01 01:00:00"), endtime);
+    REQUIRE(ret.size() == 1);
+    REQUIRE(*ret[0].data.data_value == Approx(7.0));
+  }
+
+  SECTION("Aggregated rows are not changed by aggregating them again")
+  {
+    const auto spec = make_spec(AggregationSpec::Function::Mean);
+    const auto ret = aggregateObservations(observations, spec, starttime, endtime);
+    const auto again = aggregateObservations(ret, spec, starttime, endtime);
+    REQUIRE(again.size() == ret.size());
+    for (std::size_t i = 0; i < ret.size(); i++)
+    {
+      REQUIRE(again[i].data.data_time == ret[i].data.data_time);
+      REQUIRE(*again[i].data.data_value == Approx(*ret[i].data.data_value));
+    }
+  }
+}
+
+TEST_CASE("Aggregating several stations and measurands")
+{
+  const LocationDataItems observations{make_obs(2, 1, "2024-01-01 00:10:00", 1.0),
+                                       make_obs(2, 2, "2024-01-01 00:20:00", 10.0),
+                                       make_obs(2, 1, "2024-01-01 00:30:00", 3.0),
+                                       make_obs(1, 1, "2024-01-01 00:30:00", 5.0),
+                                       make_obs(1, 1, "2024-01-01 00:40:00", {})};
+
+  const auto ret = aggregateObservations(observations,
+                                         make_spec(AggregationSpec::Function::Mean),
+                                         t("2024-01-01 00:00:00"),
+                                         t("2024-01-01 01:00:00"));
+
+  // Stations keep their order, measurands of a bucket are ordered by id
+  REQUIRE(ret.size() == 3);
+  REQUIRE(ret[0].data.fmisid == 2);
+  REQUIRE(ret[0].data.measurand_id == 1);
+  REQUIRE(*ret[0].data.data_value == Approx(2.0));
+  REQUIRE(ret[1].data.fmisid == 2);
+  REQUIRE(ret[1].data.measurand_id == 2);
+  REQUIRE(*ret[1].data.data_value == Approx(10.0));
+  REQUIRE(ret[2].data.fmisid == 1);
+  REQUIRE(*ret[2].data.data_value == Approx(5.0));
+}
+
+TEST_CASE("Buckets without values have no value")
+{
+  const LocationDataItems observations{make_obs(1, 1, "2024-01-01 00:10:00", {})};
+  const auto ret = aggregateObservations(observations,
+                                         make_spec(AggregationSpec::Function::Sum),
+                                         t("2024-01-01 00:00:00"),
+                                         t("2024-01-01 01:00:00"));
+  REQUIRE(ret.size() == 1);
+  REQUIRE_FALSE(ret[0].data.data_value);
+}
@@ -0,0 +1,138 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "DataCoverage.h"
+#include <macgyver/DateTime.h>
+
+using namespace SmartMet;
+using namespace SmartMet::Engine::Observation;
+
+namespace
+{
+Fmi::DateTime t(const char* str)
+{
+  return Fmi::DateTime::from_string(str);
+}
+
+Spine::Stations make_stations(const std::vector<int>& fmisids)
+{
+  Spine::Stations stations;
+  for (auto fmisid : fmisids)
+  {
+    Spine::Station station;
+    station.fmisid = fmisid;
+    stations.push_back(station);
+  }
+  return stations;
+}
+
+std::vector<int> fmisids_of(const Spine::Stations& stations)
+{
+  std::vector<int> ret;
+  for (const auto& station : stations)
+    ret.push_back(station.fmisid);
+  return ret;
+}
+
+}  // namespace
+
+TEST_CASE("Data coverage")
+{
+  DataCoverage coverage;
+
+  // Station 1 measures temperature (1) and wind (2), station 2 only temperature
+  coverage.add(1, 1, t("2024-01-01 00:00:00"), t("2024-01-02 00:00:00"));
+  coverage.add(1, 2, t("2024-01-01 12:00:00"), t("2024-01-01 18:00:00"));
+  coverage.add(2, 1, t("2024-01-01 06:00:00"), t("2024-01-01 09:00:00"));
+
+  const std::vector<int> fmisids{1, 2, 3};
+
+  SECTION("Everything passes before the coverage is complete")
+  {
+    REQUIRE_FALSE(coverage.complete());
+    REQUIRE(coverage.stationsWithData(fmisids, {2}, t("2023-01-01 00:00:00"),
+                                      t("2023-01-02 00:00:00")) == std::set<int>{1, 2, 3});
+
+    auto stations = make_stations(fmisids);
+    std::vector<int> measurands{1, 2, 3};
+    coverage.prune(stations, measurands, t("2023-01-01 00:00:00"), t("2023-01-02 00:00:00"));
+    REQUIRE(stations.size() == 3);
+    REQUIRE(measurands == std::vector<int>{1, 2, 3});
+  }
+
+  coverage.setComplete();
+
+  SECTION("Stations with data in the interval")
+  {
+    REQUIRE(coverage.stationsWithData(fmisids, {1}, t("2024-01-01 08:00:00"),
+                                      t("2024-01-01 10:00:00")) == std::set<int>{1, 2});
+    REQUIRE(coverage.stationsWithData(fmisids, {2}, t("2024-01-01 08:00:00"),
+                                      t("2024-01-01 10:00:00"))
+                .empty());
+    // The interval end points are inclusive
+    REQUIRE(coverage.stationsWithData(fmisids, {2}, t("2024-01-01 18:00:00"),
+                                      t("2024-01-01 20:00:00")) == std::set<int>{1});
+  }
+
+  SECTION("Pruning keeps everything that may have data")
+  {
+    auto stations = make_stations(fmisids);
+    std::vector<int> measurands{1, 2, 3};
+    coverage.prune(stations, measurands, t("2024-01-01 08:00:00"), t("2024-01-01 13:00:00"));
+    REQUIRE(fmisids_of(stations) == std::vector<int>{1, 2});
+    REQUIRE(measurands == std::vector<int>{1, 2});
+
+    // The span is only an envelope, a gap in the data does not prune anything
+    coverage.add(2, 1, t("2024-01-01 20:00:00"), t("2024-01-01 21:00:00"));
+    stations = make_stations(fmisids);
+    measurands = {1};
+    coverage.prune(stations, measurands, t("2024-01-01 12:00:00"), t("2024-01-01 13:00:00"));
+    REQUIRE(fmisids_of(stations) == std::vector<int>{1, 2});
+  }
+
+  SECTION("Pruning without any data")
+  {
+    auto stations = make_stations(fmisids);
+    std::vector<int> measurands{1, 2};
+    coverage.prune(stations, measurands, t("2024-02-01 00:00:00"), t("2024-02-02 00:00:00"));
+    REQUIRE(stations.empty());
+    REQUIRE(measurands.empty());
+  }
+
+  SECTION("Cleaning trims and drops spans")
+  {
+    coverage.clean(t("2024-01-01 10:00:00"));
+
+    // Station 2 had data only before the cleaning time
+    REQUIRE(coverage.stationsWithData(fmisids, {1}, t("2024-01-01 00:00:00"),
+                                      t("2024-01-02 00:00:00")) == std::set<int>{1});
+
+    // Station 1 temperature now starts at the cleaning time
+    REQUIRE(coverage.stationsWithData(fmisids, {1}, t("2024-01-01 08:00:00"),
+                                      t("2024-01-01 09:00:00"))
+                .empty());
+    REQUIRE(coverage.stationsWithData(fmisids, {1}, t("2024-01-01 08:00:00"),
+                                      t("2024-01-01 10:00:00")) == std::set<int>{1});
+
+    // Station 1 wind is untouched
+    REQUIRE(coverage.stationsWithData(fmisids, {2}, t("2024-01-01 12:00:00"),
+                                      t("2024-01-01 12:00:00")) == std::set<int>{1});
+  }
+
+  SECTION("New observations extend the spans")
+  {
+    DataItem item;
+    item.fmisid = 3;
+    item.measurand_id = 2;
+    item.data_time = t("2024-01-03 00:00:00");
+    coverage.add(DataItems{item});
+
+    REQUIRE(coverage.stationsWithData(fmisids, {2}, t("2024-01-02 12:00:00"),
+                                      t("2024-01-03 12:00:00")) == std::set<int>{3});
+  }
+}
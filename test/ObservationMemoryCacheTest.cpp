@@ -73,6 +73,115 @@ TEST_CASE("Test modified_last")
   }
 }
 
+TEST_CASE("Test latest observation query")
+{
+  SECTION("Only the latest time in the interval is read")
+  {
+    Fmi::DateTime starttime = Fmi::DateTime::from_string("2020-01-01 00:00:00");
+    Fmi::DateTime endtime = Fmi::DateTime::from_string("2020-01-01 03:00:00");
+    int fmisid = 101004;
+
+    SmartMet::Engine::Observation::ObservationMemoryCache cache;
+
+    // Hourly observations of two measurands until 05:00, measurand 1 missing at 03:00
+    SmartMet::Engine::Observation::DataItems items;
+    for (int hour = 0; hour <= 5; hour++)
+    {
+      for (int measurand_id = 0; measurand_id < 2; measurand_id++)
+      {
+        if (hour == 3 && measurand_id == 1)
+          continue;
+        SmartMet::Engine::Observation::DataItem item;
+        item.data_time = starttime + Fmi::Hours(hour);
+        item.modified_last = item.data_time;
+        item.data_value = hour;
+        item.fmisid = fmisid;
+        item.measurand_id = measurand_id;
+        item.data_quality = 1;
+        item.producer_id = 1;
+        items.push_back(item);
+      }
+    }
+    cache.fill(items);
+
+    SmartMet::Engine::Observation::Settings settings;
+    settings.starttime = starttime;
+    settings.endtime = endtime;
+    settings.wantedtime = endtime;
+    settings.starttimeGiven = true;
+    settings.producer_ids.insert(1);
+    SmartMet::Spine::Station station;
+    station.fmisid = fmisid;
+    SmartMet::Spine::Stations stations{station};
+
+    std::set<std::string> groups;
+    SmartMet::Engine::Observation::QueryMapping qmap;
+    qmap.sensorNumberToMeasurandIds[-1] = std::set<int>{0, 1};
+    qmap.measurandIds = {0, 1};
+
+    auto obs = cache.read_observations(stations, settings, stationinfo, groups, qmap);
+    REQUIRE(obs.size() == 1);
+    REQUIRE(obs[0].data.data_time == endtime);
+
+    // Measurand 1 only: its latest observation is at 02:00
+    qmap.measurandIds = {1};
+    obs = cache.read_observations(stations, settings, stationinfo, groups, qmap);
+    REQUIRE(obs.size() == 1);
+    REQUIRE(obs[0].data.data_time == starttime + Fmi::Hours(2));
+  }
+}
+
+TEST_CASE("Test aggregated latest observation query")
+{
+  SECTION("The last complete bucket is returned")
+  {
+    Fmi::DateTime starttime = Fmi::DateTime::from_string("2020-01-01 10:00:00");
+    Fmi::DateTime endtime = Fmi::DateTime::from_string("2020-01-01 12:30:00");
+    int fmisid = 101004;
+
+    SmartMet::Engine::Observation::ObservationMemoryCache cache;
+
+    // Observations every 10 minutes from 10:00 to 13:00, the value is the hour
+    SmartMet::Engine::Observation::DataItems items;
+    for (int minutes = 0; minutes <= 180; minutes += 10)
+    {
+      SmartMet::Engine::Observation::DataItem item;
+      item.data_time = starttime + Fmi::Minutes(minutes);
+      item.modified_last = item.data_time;
+      item.data_value = 10 + (minutes - 1) / 60;
+      item.fmisid = fmisid;
+      item.data_quality = 1;
+      item.producer_id = 1;
+      items.push_back(item);
+    }
+    cache.fill(items);
+
+    SmartMet::Engine::Observation::Settings settings;
+    settings.starttime = starttime;
+    settings.endtime = endtime;
+    settings.wantedtime = endtime;
+    settings.starttimeGiven = true;
+    settings.producer_ids.insert(1);
+    SmartMet::Engine::Observation::AggregationSpec spec;
+    spec.interval = 60;
+    settings.aggregation = spec;
+    SmartMet::Spine::Station station;
+    station.fmisid = fmisid;
+    SmartMet::Spine::Stations stations{station};
+
+    std::set<std::string> groups;
+    SmartMet::Engine::Observation::QueryMapping qmap;
+    qmap.sensorNumberToMeasurandIds[-1] = std::set<int>{0};
+    qmap.measurandIds = {0};
+
+    auto obs = cache.read_observations(stations, settings, stationinfo, groups, qmap);
+    REQUIRE(obs.size() == 2);
+    REQUIRE(obs[0].data.data_time == Fmi::DateTime::from_string("2020-01-01 11:00:00"));
+    REQUIRE(obs[1].data.data_time == Fmi::DateTime::from_string("2020-01-01 12:00:00"));
+    REQUIRE(*obs[1].data.data_value == Approx(11.0));
+  }
+}
+
 TEST_CASE("Test observation memory cache in parallel (TSAN)")
 {
   SECTION("Insert and find in parallel")
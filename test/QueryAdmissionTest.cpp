@@ -0,0 +1,146 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "QueryAdmission.h"
+#include <macgyver/DateTime.h>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace SmartMet;
+using namespace SmartMet::Engine::Observation;
+
+namespace
+{
+Settings make_settings()
+{
+  Settings settings;
+  settings.stationtype = "observations_fmi";
+  settings.starttime = Fmi::DateTime::from_string("2024-01-01 00:00:00");
+  settings.endtime = Fmi::DateTime::from_string("2024-01-01 10:00:00");
+  for (const auto* name : {"temperature", "windspeedms", "humidity"})
+    settings.parameters.emplace_back(name, Spine::Parameter::Type::Data);
+  return settings;
+}
+
+QueryAdmissionLimits heavy_limits()
+{
+  QueryAdmissionLimits limits;
+  limits.heavyQueryValues = 100;
+  limits.maxHeavyQueryWeight = 2;
+  limits.queueTimeout = 10000;
+  return limits;
+}
+
+}  // namespace
+
+TEST_CASE("Query size estimate")
+{
+  QueryAdmission admission(QueryAdmissionLimits{});
+  const auto settings = make_settings();
+
+  // 2 stations x 3 parameters x 10 hours x 6 samples
+  REQUIRE(admission.estimate(settings, 2) == 360);
+
+  // The timestep overrides the sampling rate
+  REQUIRE(admission.estimate(settings, 2, 30) == 120);
+
+  // The sampling rate is learned from queries returning all data
+  admission.record(settings, 2, 240);
+  REQUIRE(admission.estimate(settings, 2) == 720);
+  REQUIRE(admission.estimate(settings, 2, 30) == 120);
+
+  // Other stationtypes are unaffected
+  auto other = settings;
+  other.stationtype = "road";
+  REQUIRE(admission.estimate(other, 2) == 360);
+}
+
+TEST_CASE("Query rejection")
+{
+  QueryAdmissionLimits limits;
+  limits.maxValues = 1000;
+  QueryAdmission admission(limits);
+  const auto settings = make_settings();
+
+  REQUIRE(admission.enabled());
+  REQUIRE_NOTHROW(admission.admit(settings, 1000));
+  REQUIRE_THROWS(admission.admit(settings, 1001));
+}
+
+TEST_CASE("Heavy queries wait for their weight")
+{
+  QueryAdmission admission(heavy_limits());
+  const auto settings = make_settings();
+
+  auto permit = admission.admit(settings, 200);
+
+  // Light queries are not limited
+  REQUIRE_NOTHROW(admission.admit(settings, 99));
+
+  auto waiting = std::async(std::launch::async,
+                            [&admission, &settings]()
+                            {
+                              auto p = admission.admit(settings, 100);
+                              return p != nullptr;
+                            });
+
+  REQUIRE(waiting.wait_for(std::chrono::milliseconds(300)) == std::future_status::timeout);
+
+  permit.reset();
+  REQUIRE(waiting.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+  REQUIRE(waiting.get());
+}
+
+TEST_CASE("Heavy query queue timeout")
+{
+  auto limits = heavy_limits();
+  limits.queueTimeout = 200;
+  QueryAdmission admission(limits);
+  const auto settings = make_settings();
+
+  auto permit = admission.admit(settings, 200);
+
+  const auto start = std::chrono::steady_clock::now();
+  REQUIRE_THROWS(admission.admit(settings, 100));
+  REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(200));
+
+  // A query heavier than the limit may run alone
+  permit.reset();
+  REQUIRE_NOTHROW(admission.admit(settings, 1000));
+}
+
+TEST_CASE("Cancelled queries stop waiting")
+{
+  QueryAdmission admission(heavy_limits());
+  auto settings = make_settings();
+
+  auto permit = admission.admit(settings, 200);
+
+  SECTION("Cancellation")
+  {
+    settings.cancellation = std::make_shared<QueryCancellation>();
+    auto waiting = std::async(std::launch::async,
+                              [&admission, &settings]() { admission.admit(settings, 100); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    settings.cancellation->cancel();
+
+    REQUIRE(waiting.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    REQUIRE_THROWS(waiting.get());
+  }
+
+  SECTION("Deadline")
+  {
+    settings.cancellation = std::make_shared<QueryCancellation>(std::chrono::milliseconds(200));
+
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE_THROWS(admission.admit(settings, 100));
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+  }
+}
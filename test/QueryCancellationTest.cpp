@@ -0,0 +1,70 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "QueryCancellation.h"
+#include <chrono>
+#include <thread>
+
+using namespace SmartMet::Engine::Observation;
+
+TEST_CASE("Queries without a token are never cancelled")
+{
+  QueryCancellationPtr token;
+  REQUIRE_FALSE(isCancelled(token));
+  REQUIRE_NOTHROW(checkCancellation(token));
+
+  QueryCancellation unlimited;
+  REQUIRE_FALSE(unlimited.cancelled());
+  REQUIRE_FALSE(unlimited.remaining());
+}
+
+TEST_CASE("Query cancellation")
+{
+  auto token = std::make_shared<QueryCancellation>();
+  REQUIRE_NOTHROW(checkCancellation(token));
+
+  int calls = 0;
+  auto registration = token->onCancel([&calls]() { ++calls; });
+
+  token->cancel();
+  REQUIRE(isCancelled(token));
+  REQUIRE_THROWS(checkCancellation(token));
+  REQUIRE(calls == 1);
+
+  // Cancelling again does not rerun the callbacks
+  token->cancel();
+  REQUIRE(calls == 1);
+
+  // Callbacks registered after the cancellation are run immediately
+  auto late = token->onCancel([&calls]() { ++calls; });
+  REQUIRE(calls == 2);
+}
+
+TEST_CASE("Unregistered callbacks are not run")
+{
+  auto token = std::make_shared<QueryCancellation>();
+
+  int calls = 0;
+  token->onCancel([&calls]() { ++calls; });
+  token->cancel();
+  REQUIRE(calls == 0);
+}
+
+TEST_CASE("Query deadline")
+{
+  auto token = std::make_shared<QueryCancellation>(std::chrono::milliseconds(100));
+  REQUIRE_FALSE(isCancelled(token));
+  REQUIRE(token->remaining());
+  REQUIRE(*token->remaining() <= std::chrono::milliseconds(100));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+  REQUIRE(isCancelled(token));
+  REQUIRE_THROWS(checkCancellation(token));
+  REQUIRE(*token->remaining() == std::chrono::milliseconds(0));
+}
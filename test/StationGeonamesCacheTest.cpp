@@ -0,0 +1,86 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "StationGeonamesCache.h"
+#include <filesystem>
+
+using namespace SmartMet;
+using namespace SmartMet::Engine::Observation;
+
+namespace
+{
+Spine::Station make_station(int fmisid, double lon, double lat)
+{
+  Spine::Station station;
+  station.fmisid = fmisid;
+  station.longitude = lon;
+  station.latitude = lat;
+  return station;
+}
+
+}  // namespace
+
+TEST_CASE("Station Geonames cache")
+{
+  const std::string filename = "/tmp/smartmet-observation-geonames-test.bin";
+  std::filesystem::remove(filename);
+
+  // A station which has moved has a row for each location
+  auto oldrow = make_station(100971, 24.94, 60.17);
+  oldrow.geoid = 1;
+  oldrow.timezone = "Europe/Helsinki";
+  auto newrow = make_station(100971, 24.95, 60.18);
+  newrow.geoid = 2;
+  newrow.timezone = "Europe/Helsinki";
+
+  {
+    StationGeonamesCache cache(filename, 0);
+    cache.set(oldrow, "fi");
+    cache.set(newrow, "fi");
+    cache.save();
+  }
+
+  StationGeonamesCache cache(filename, 0);
+
+  SECTION("Each location has its own entry")
+  {
+    auto station = make_station(100971, 24.94, 60.17);
+    REQUIRE(cache.get(station, "fi"));
+    REQUIRE(station.geoid == 1);
+    REQUIRE(station.timezone == "Europe/Helsinki");
+
+    station = make_station(100971, 24.95, 60.18);
+    REQUIRE(cache.get(station, "fi"));
+    REQUIRE(station.geoid == 2);
+  }
+
+  SECTION("Unknown locations and languages miss")
+  {
+    auto station = make_station(100971, 25.00, 60.20);
+    REQUIRE_FALSE(cache.get(station, "fi"));
+
+    station = make_station(100971, 24.94, 60.17);
+    REQUIRE_FALSE(cache.get(station, "en"));
+  }
+
+  SECTION("Entries of removed stations and locations are pruned")
+  {
+    cache.retain(Spine::Stations{make_station(100971, 24.95, 60.18)});
+    cache.save();
+
+    StationGeonamesCache reloaded(filename, 0);
+    auto station = make_station(100971, 24.94, 60.17);
+    REQUIRE_FALSE(reloaded.get(station, "fi"));
+
+    station = make_station(100971, 24.95, 60.18);
+    REQUIRE(reloaded.get(station, "fi"));
+    REQUIRE(station.geoid == 2);
+  }
+
+  std::filesystem::remove(filename);
+}
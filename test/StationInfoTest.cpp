@@ -9,6 +9,11 @@
 #include "StationInfo.h"
 #include <macgyver/StringConversion.h>
 #include <macgyver/TimeZones.h>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
 
 std::string stationFile = "/usr/share/smartmet/test/data/sqlite/stations.txt";
 
@@ -99,6 +104,195 @@ TEST_CASE("Cached nearest-station candidate lists")
   }
 }
 
+TEST_CASE("Bounding box searches")
+{
+  // The grid index must return the same stations in the same order as a full scan
+  auto scan = [](double minx, double miny, double maxx, double maxy)
+  {
+    SmartMet::Spine::Stations result;
+    for (const auto& station : stationinfo.stations)
+    {
+      const bool lonok = (maxx > minx ? station.longitude >= minx && station.longitude <= maxx
+                                      : station.longitude >= minx || station.longitude <= maxx);
+      if (lonok && station.latitude >= miny && station.latitude <= maxy &&
+          !(endtime < station.station_start || starttime > station.station_end))
+        result.push_back(station);
+    }
+    return result;
+  };
+
+  std::set<std::string> groups;
+
+  SECTION("Normal bounding box")
+  {
+    auto stations =
+        stationinfo.findStationsInsideBox(24.5, 60.0, 25.5, 60.5, groups, starttime, endtime);
+    REQUIRE(!stations.empty());
+    REQUIRE(same_stations(stations, scan(24.5, 60.0, 25.5, 60.5)));
+  }
+
+  SECTION("Bounding box spanning the 180th meridian")
+  {
+    auto stations =
+        stationinfo.findStationsInsideBox(30.0, -90, -30.0, 90, groups, starttime, endtime);
+    REQUIRE(same_stations(stations, scan(30.0, -90, -30.0, 90)));
+    for (const auto& station : stations)
+      REQUIRE((station.longitude >= 30.0 || station.longitude <= -30.0));
+  }
+}
+
+TEST_CASE("Area searches")
+{
+  std::set<std::string> aws{"AWS"};
+  const std::string wkt = "POLYGON ((24.5 60,25.5 60,25.5 60.5,24.5 60.5,24.5 60))";
+
+  auto byfmisid = [](const auto& a, const auto& b) { return a.fmisid < b.fmisid; };
+
+  auto expected =
+      stationinfo.findStationsInsideBox(24.5, 60.0, 25.5, 60.5, aws, starttime, endtime);
+  std::sort(expected.begin(), expected.end(), byfmisid);
+
+  // The second search uses the cached geometry
+  auto first = stationinfo.findStationsInsideArea(aws, starttime, endtime, wkt);
+  auto second = stationinfo.findStationsInsideArea(aws, starttime, endtime, wkt);
+
+  REQUIRE(!first.empty());
+  REQUIRE(same_stations(first, expected));
+  REQUIRE(same_stations(second, expected));
+}
+
+TEST_CASE("Binary station snapshots")
+{
+  const std::string snapshotFile = "/tmp/smartmet-observation-stations-test.bin";
+  stationinfo.serialize(snapshotFile);
+
+  SmartMet::Engine::Observation::StationInfo snapshot(snapshotFile);
+  std::filesystem::remove(snapshotFile);
+
+  std::set<std::string> aws{"AWS"};
+
+  REQUIRE(snapshot.stations.size() == stationinfo.stations.size());
+  REQUIRE(snapshot.getStation(100971, aws, starttime).formal_name_fi == "Helsinki Kaisaniemi");
+  REQUIRE(same_stations(
+      snapshot.findNearestStations(24.94459, 60.17522999999999, 50000, 5, aws, starttime, endtime),
+      stationinfo.findNearestStations(
+          24.94459, 60.17522999999999, 50000, 5, aws, starttime, endtime)));
+  REQUIRE(same_stations(
+      snapshot.findStationsInsideBox(24.5, 60.0, 25.5, 60.5, aws, starttime, endtime),
+      stationinfo.findStationsInsideBox(24.5, 60.0, 25.5, 60.5, aws, starttime, endtime)));
+  REQUIRE(same_stations(snapshot.findStationsInGroup(aws, starttime, endtime),
+                        stationinfo.findStationsInGroup(aws, starttime, endtime)));
+  REQUIRE(same_stations(snapshot.findFmisidStations(std::vector<int>{100971, 101004}),
+                        stationinfo.findFmisidStations(std::vector<int>{100971, 101004})));
+}
+
+TEST_CASE("Incompatible station snapshots are ignored")
+{
+  const std::string snapshotFile = "/tmp/smartmet-observation-stations-test-version.bin";
+  stationinfo.serialize(snapshotFile);
+
+  // Overwrite the version number following the magic bytes
+  {
+    std::fstream file(snapshotFile, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(8);
+    const std::uint32_t version = 0xFFFFFFFF;
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  }
+
+  std::unique_ptr<SmartMet::Engine::Observation::StationInfo> snapshot;
+  REQUIRE_NOTHROW(
+      snapshot = std::make_unique<SmartMet::Engine::Observation::StationInfo>(snapshotFile));
+  std::filesystem::remove(snapshotFile);
+
+  REQUIRE(snapshot->stations.empty());
+}
+
+TEST_CASE("Station group masks")
+{
+  const auto aws = stationinfo.groupMask({"AWS"});
+  const auto road = stationinfo.groupMask({"EXTRWS"});
+  const auto both = stationinfo.groupMask({"AWS", "EXTRWS"});
+
+  REQUIRE(stationinfo.belongsToGroup(100971, aws));
+  REQUIRE(!stationinfo.belongsToGroup(100971, road));
+  REQUIRE(stationinfo.belongsToGroup(100971, both));
+  REQUIRE(stationinfo.belongsToGroup(100971, stationinfo.groupMask({})));
+  REQUIRE(!stationinfo.belongsToGroup(100971, stationinfo.groupMask({"NOSUCHGROUP"})));
+  REQUIRE(!stationinfo.belongsToGroup(1, stationinfo.groupMask({})));
+}
+
+TEST_CASE("Station name searches")
+{
+  // Compare with a scan of all the names
+  auto scan = [](const std::string& text, bool prefix)
+  {
+    const auto pattern = Fmi::ascii_toupper_copy(text);
+    std::set<int> ret;
+    for (const auto& station : stationinfo.stations)
+    {
+      const auto name = Fmi::ascii_toupper_copy(station.formal_name_fi);
+      if (prefix ? name.compare(0, pattern.size(), pattern) == 0
+                 : name.find(pattern) != std::string::npos)
+        ret.insert(station.fmisid);
+    }
+    return ret;
+  };
+
+  for (const std::string text : {"lahti", "Kärpäsenmäki", "LA", "x", "kk", "nosuchname"})
+  {
+    REQUIRE(stationinfo.findFmisidsByName(text) == scan(text, false));
+    REQUIRE(stationinfo.findFmisidsByName(text, true) == scan(text, true));
+  }
+
+  REQUIRE(stationinfo.findFmisidsByName("kärpäsenmäki_opt").count(100205) == 1);
+}
+
+TEST_CASE("Patching stations")
+{
+  std::set<std::string> aws{"AWS"};
+  const auto helsinki = stationinfo.findFmisidStations(std::vector<int>{100971});
+  REQUIRE(!helsinki.empty());
+
+  SECTION("Modified names keep the layout")
+  {
+    auto rows = helsinki;
+    for (auto& row : rows)
+      row.formal_name_fi = "Kaisaniemi";
+
+    auto patched = stationinfo.patch({100971}, rows);
+    REQUIRE(patched->layout() == stationinfo.layout());
+    REQUIRE(patched->getStation(100971, aws, starttime).formal_name_fi == "Kaisaniemi");
+    REQUIRE(stationinfo.getStation(100971, aws, starttime).formal_name_fi ==
+            "Helsinki Kaisaniemi");
+    REQUIRE(same_stations(patched->findNearestStations(
+                              24.94459, 60.17522999999999, 50000, 5, aws, starttime, endtime),
+                          stationinfo.findNearestStations(
+                              24.94459, 60.17522999999999, 50000, 5, aws, starttime, endtime)));
+  }
+
+  SECTION("Moved stations change the layout")
+  {
+    auto rows = helsinki;
+    for (auto& row : rows)
+      row.longitude += 10;
+
+    auto patched = stationinfo.patch({100971}, rows);
+    REQUIRE(patched->layout() != stationinfo.layout());
+    REQUIRE(patched->stations.size() == stationinfo.stations.size());
+
+    auto stations = patched->findStationsInsideBox(34.5, 60.0, 35.5, 60.5, aws, starttime, endtime);
+    REQUIRE(stations.size() == 1);
+    REQUIRE(stations.front().fmisid == 100971);
+  }
+
+  SECTION("Removed stations")
+  {
+    auto patched = stationinfo.patch({100971}, {});
+    REQUIRE(patched->findFmisidStations(std::vector<int>{100971}).empty());
+    REQUIRE(patched->stations.size() == stationinfo.stations.size() - helsinki.size());
+  }
+}
+
 TEST_CASE("Test station and data searches")
 {
   SECTION("Search Stations using AWS group")
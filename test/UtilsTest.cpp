@@ -0,0 +1,55 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "Settings.h"
+#include "Utils.h"
+#include <macgyver/DateTime.h>
+
+using namespace SmartMet::Engine::Observation;
+
+TEST_CASE("Hybrid query split time")
+{
+  Settings settings;
+  settings.starttime = Fmi::DateTime::from_string("2024-01-01 00:00:00");
+  settings.endtime = Fmi::DateTime::from_string("2024-01-01 12:00:00");
+  settings.timestep = 10;
+
+  const auto cacheStart = Fmi::DateTime::from_string("2024-01-01 05:25:00");
+  const auto margin = Fmi::Hours(1);
+
+  SECTION("The split is on the timestep grid")
+  {
+    REQUIRE(Utils::hybridQuerySplitTime(settings, cacheStart, margin) ==
+            Fmi::DateTime::from_string("2024-01-01 06:30:00"));
+  }
+
+  SECTION("Aggregation bucket straddling the split")
+  {
+    // The hourly bucket 06:00-07:00 would be aggregated in both the database and the cache
+    AggregationSpec spec;
+    spec.interval = 60;
+    settings.aggregation = spec;
+    REQUIRE(Utils::hybridQuerySplitTime(settings, cacheStart, margin).is_not_a_date_time());
+  }
+
+  SECTION("The split must be inside the interval")
+  {
+    settings.endtime = Fmi::DateTime::from_string("2024-01-01 06:00:00");
+    REQUIRE(Utils::hybridQuerySplitTime(settings, cacheStart, margin).is_not_a_date_time());
+
+    settings.starttime = Fmi::DateTime::from_string("2024-01-01 07:00:00");
+    settings.endtime = Fmi::DateTime::from_string("2024-01-01 12:00:00");
+    REQUIRE(Utils::hybridQuerySplitTime(settings, cacheStart, margin).is_not_a_date_time());
+  }
+
+  SECTION("Unknown cache start")
+  {
+    REQUIRE(Utils::hybridQuerySplitTime(settings, Fmi::DateTime::NOT_A_DATE_TIME, margin)
+                .is_not_a_date_time());
+  }
+}
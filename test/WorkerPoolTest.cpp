@@ -0,0 +1,69 @@
+#define CATCH_CONFIG_MAIN
+
+#if __cplusplus >= 201402L
+#include <catch2/catch.hpp>
+#else
+#include <catch/catch.hpp>
+#endif
+
+#include "WorkerPool.h"
+#include <atomic>
+#include <future>
+#include <stdexcept>
+
+using namespace SmartMet::Engine::Observation;
+
+TEST_CASE("Worker pool runs every part once")
+{
+  WorkerPool pool(3);
+  REQUIRE(pool.size() == 3);
+
+  std::vector<std::atomic<int>> calls(100);
+  pool.run(calls.size(), [&calls](std::size_t i) { ++calls[i]; });
+  for (const auto& count : calls)
+    REQUIRE(count == 1);
+
+  // Nothing to do
+  REQUIRE_NOTHROW(pool.run(0, [](std::size_t) { throw std::runtime_error("unexpected"); }));
+}
+
+TEST_CASE("Worker pool without workers runs in the caller")
+{
+  WorkerPool pool(0);
+  int sum = 0;
+  pool.run(10, [&sum](std::size_t i) { sum += static_cast<int>(i); });
+  REQUIRE(sum == 45);
+}
+
+TEST_CASE("Worker pool errors are rethrown after all parts have finished")
+{
+  WorkerPool pool(2);
+  std::atomic<int> calls{0};
+  REQUIRE_THROWS(pool.run(10,
+                          [&calls](std::size_t i)
+                          {
+                            ++calls;
+                            if (i == 3)
+                              throw std::runtime_error("failed");
+                          }));
+  REQUIRE(calls == 10);
+}
+
+TEST_CASE("Worker pool is shared by concurrent callers")
+{
+  WorkerPool pool(2);
+
+  auto sum = [&pool]()
+  {
+    std::atomic<long> total{0};
+    pool.run(1000, [&total](std::size_t i) { total += static_cast<long>(i); });
+    return total.load();
+  };
+
+  std::vector<std::future<long>> results;
+  for (int i = 0; i < 8; i++)
+    results.push_back(std::async(std::launch::async, sum));
+
+  for (auto& result : results)
+    REQUIRE(result.get() == 499500);
+}